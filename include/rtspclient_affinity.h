@@ -0,0 +1,30 @@
+#ifndef __RTSPCLIENT_AFFINITY_H
+#define __RTSPCLIENT_AFFINITY_H
+/*
+ * Placement of the event loop thread: the CPUs it may run on, its scheduling policy and priority, and the
+ * NUMA node that its memory comes from.
+ *
+ * Every per-session buffer (sink frame buffers, batched-read caches, reordering rings, ...) is allocated by the
+ * event loop thread, so once the thread prefers a node, they're all allocated there ('first touch').
+ *
+*/
+
+#include <pthread.h>
+#include <sched.h>
+#include "Boolean.hh"
+
+class RTSPClientThreadPlacement {
+public:
+  static Boolean parseCPUList(char const* cpuList, cpu_set_t& cpuSet);
+      // Parses a list like "0-3,6" (as in "taskset -c").  Returns False if it's malformed, or names no CPU.
+  static Boolean getNodeCPUs(int node, cpu_set_t& cpuSet);
+      // Returns False if there's no such NUMA node (or it has no CPUs).
+
+  static Boolean setAttributes(pthread_attr_t* attr, char const* cpuList, int node, int policy, int priority);
+      // Sets up "attr" for a thread that runs on "cpuList" (or, if it's empty, on the CPUs of "node" (if >= 0)),
+      // with "policy" (SCHED_OTHER, SCHED_FIFO or SCHED_RR) and "priority".  Returns False if any of these is invalid.
+  static Boolean preferNode(int node);
+      // Makes the calling thread's memory allocations come from "node" where possible.
+};
+
+#endif // __RTSPCLIENT_AFFINITY_H
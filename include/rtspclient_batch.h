@@ -0,0 +1,61 @@
+#ifndef __RTSPCLIENT_BATCH_H
+#define __RTSPCLIENT_BATCH_H
+/*
+ * Batched reception for RTP-over-UDP sockets, and buffered reception for RTP-over-TCP ('interleaved') connections.
+ *
+ * live555 reads each incoming packet with its own "readSocket()" (i.e., "recvfrom()") call, after its own
+ * "select()".  For a socket that's been "enable()"d, our "readSocket()" - which takes the place of live555's -
+ * instead drains up to RTSPCLIENT_BATCH_SIZE datagrams with one "recvmmsg()", and returns the rest from a
+ * per-socket cache on the following calls.  (The first datagram goes straight into the caller's buffer; the
+ * rest are copied once, from the cache.)  "RTSPClientTaskScheduler" calls the socket's handler again while
+ * packets are pending, without another "select()".  (If the scheduler uses io_uring, the kernel receives the packets
+ * instead - see "rtspclient_uring.h" - and our "readSocket()" returns them from its buffer pool.)
+ *
+ * Over TCP, live555 makes several small reads per interleaved frame (the '$', the channel id, the length, and
+ * then the packet itself).  For a connection that's been "enableStream()"d, our "readSocket()" instead reads up to
+ * RTSPCLIENT_STREAM_BUFFER_BYTES at a time into a per-connection buffer, and serves these reads from it.  The
+ * scheduler keeps calling the connection's handler until the buffer is empty, so every complete frame in a chunk
+ * gets demultiplexed (to its RTP or RTCP handler) in one pass.  The buffer is refilled only once it's empty, so
+ * the tail of a partial frame is never moved; it's just read (from the start of the buffer) after the next refill.
+ *
+*/
+
+#include "NetCommon.h"
+#include "Boolean.hh"
+
+#define RTSPCLIENT_BATCH_SIZE           32
+#define RTSPCLIENT_BATCH_SLOT_BYTES     2048 // larger datagrams make us stop batching on that socket
+#define RTSPCLIENT_STREAM_BUFFER_BYTES  65536
+#define RTSPCLIENT_REORDER_LOG2_SLOTS   10 // i.e., a window of 1024 packets
+
+class RTSPClientReorderRing; // forward
+
+class RTSPClientBatchReader {
+public:
+  static Boolean enable(int socketNum);
+      // Returns False (and leaves the socket unbatched) if our "readSocket()" can't take the place of live555's.
+  static void disable(int socketNum); // must be called before the socket is closed
+
+  static Boolean setReordering(int socketNum, unsigned thresholdUsecs, unsigned sessionId, int streamIndex);
+      // Makes a batched socket pass on its RTP packets in sequence number order (see "rtspclient_reorder.h").  A missing
+      // packet is waited for for up to "thresholdUsecs".  ("sessionId" and "streamIndex" identify the stream to tracers.)
+  static RTSPClientReorderRing* reorderRing(int socketNum); // NULL if none
+
+  static Boolean enableStream(int socketNum);
+  static void disableStream(int socketNum);
+      // must be called before the socket is closed (unless a read from it has already failed, or its handler has been removed:
+      // "RTSPClientTaskScheduler" calls this then)
+
+  static Boolean hasPendingPackets(int socketNum);
+  static unsigned pendingSockets(int* socketNums, unsigned maxSocketNums);
+      // Fills in (up to "maxSocketNums" of) the sockets that have cached packets (or buffered stream data, or reordered packets
+      // ready to be passed on); returns their number.
+  static unsigned usecsUntilNextDeadline();
+      // Returns how long until some socket should next give up waiting for a missing packet (~0 if none are waiting).
+
+  static u_int64_t arrivalUsecs(int socketNum);
+      // Returns when (by "RTSPClientLatencyHistogram::nowUsecs()") the packet that our "readSocket()" last returned for the
+      // socket was read from it (for a stream socket: when the data was); 0 if not known (e.g., the socket isn't ours).
+};
+
+#endif // __RTSPCLIENT_BATCH_H
@@ -0,0 +1,64 @@
+#ifndef __RTSPCLIENT_FRAMEBATCH_H
+#define __RTSPCLIENT_FRAMEBATCH_H
+/*
+ * Delivery of a session's frames in batches, to a "RTSPClient_BatchCallBack" (instead of one "RTSPClient_CallBack" call each).
+ *
+ * The frames of all of the session's streams are copied - in the order in which they arrive - into one contiguous buffer,
+ * and passed on in one call when:
+ *   - the batch is full, or
+ *   - a video frame ends an access unit (its RTP packet has the marker bit set), so that all the NAL units (slices, ...) of
+ *     a picture - and any audio frames that arrived with them - come in one call, without waiting for the next picture, or
+ *   - the first frame of the batch has waited for "maxDelayUsecs".
+ * The buffer is reused for every batch, so once it has grown to fit a batch, nothing is allocated per frame.  Nor is a timer
+ * scheduled per batch: the one timer is left running when a batch is delivered early, and - when it fires - is rescheduled
+ * for whenever the current batch's first frame will have waited for "maxDelayUsecs".
+ *
+*/
+
+#include <sys/time.h>
+#include "UsageEnvironment.hh"
+#include "rtspclient_self.h"
+
+class RTSPClientLatencyHistogram; // forward
+class RTSPClientLoopUsage; // forward
+
+class RTSPClientFrameBatcher {
+public:
+  RTSPClientFrameBatcher(UsageEnvironment& env, unsigned maxFrames, unsigned maxDelayUsecs,
+                         RTSPClient_BatchCallBack* callBack, void* callBackData,
+                         RTSPClientLatencyHistogram* latency = NULL/*RTSPC_LATENCY_STAGES of them, to record deliveries in*/,
+                         RTSPClientLoopUsage* loopUsage = NULL/*to attribute our timer's handler calls to*/);
+  virtual ~RTSPClientFrameBatcher(); // doesn't deliver any frames that are still batched; call "flush()" first
+      // (The callback may delete us - e.g., by stopping the session.)
+
+  int add(RTSPClientAttr const& attr, int streamIndex, u_int8_t const* data, Boolean endsAccessUnit,
+          u_int64_t arrivalUsecs = 0, u_int64_t completionUsecs = 0/*see "rtspclient_latency.h"*/);
+  int flush(); // delivers the frames that are batched (if any) now
+      // Each returns what the callback returned (RTSPC_CALLBACK_RET_*) if it was called, or RTSPC_CALLBACK_RET_OK if not.
+
+private:
+  int deliver(Boolean& deleted); // "flush()"; sets "deleted" if the callback deleted us
+  static void delayExpired(void* clientData);
+
+  UsageEnvironment& fEnv;
+  unsigned fMaxFrames;
+  unsigned fMaxDelayUsecs;
+  RTSPClient_BatchCallBack* fCallBack;
+  void* fCallBackData;
+  RTSPClientLatencyHistogram* fLatency;
+  RTSPClientLoopUsage* fLoopUsage;
+
+  RTSPClientFrame* fFrames; // "fMaxFrames" of them; their "m_pucData" are set (from "fDataOffsets") only just before delivery
+  unsigned* fDataOffsets; // of each frame's data, in "fData"
+  u_int64_t* fArrivalUsecs; // of each frame
+  u_int64_t* fCompletionUsecs; // ditto
+  unsigned fNumFrames;
+  u_int8_t* fData;
+  unsigned fDataSize, fDataCapacity;
+  struct timeval fFirstFrameTime; // of the current batch
+  TaskToken fDelayTask;
+  int fLastResult; // what the callback returned when called from "delayExpired()", for the next "add()" to return
+  Boolean* fDeletedFlag; // while we're in the callback: set by our destructor
+};
+
+#endif // __RTSPCLIENT_FRAMEBATCH_H
@@ -0,0 +1,90 @@
+#ifndef __RTSPCLIENT_FRAMEQUEUE_H
+#define __RTSPCLIENT_FRAMEQUEUE_H
+/*
+ * A bounded queue of received frames, for a session whose frames are pulled ("RTSPClientSession::GetFrame()") rather than
+ * pushed to a callback.
+ *
+ * The event loop copies each frame into a buffer from the queue's free list (so that, once the queue has warmed up, no memory
+ * is allocated per frame), and appends it.  A consumer thread takes the oldest frame, and keeps its buffer until it asks for
+ * the next frame (or releases it), which returns the buffer to the free list.  The event loop never waits for a consumer: when
+ * the queue is full, a frame is dropped, according to the queue's overflow policy.  "push()" can also be given a latency bound:
+ * once the oldest queued frame is older than that, the consumer is so far behind that the queued frames are stale, so they're
+ * all dropped (and the caller - the session's sink - then discards frames until the next keyframe).
+ *
+ * The queue also has an eventfd, for consumers that run their own "epoll()" (or "poll()") loop: it's readable while the queue
+ * has frames (or is closed), so "popAvailable()" can be called when it is.  It's written only when the queue becomes non-empty,
+ * and read only when the queue becomes empty, so a burst of frames costs two system calls, not two per frame.
+ *
+*/
+
+#include <pthread.h>
+#include "Boolean.hh"
+#include "rtspclient_self.h"
+
+class RTSPClientFrameQueue {
+public:
+  RTSPClientFrameQueue(unsigned maxFrames, int overflowPolicy/*RTSPC_FRAMEQUEUE_DROP_**/);
+  virtual ~RTSPClientFrameQueue();
+
+  Boolean hasParameters(unsigned maxFrames, int overflowPolicy) const {
+    return maxFrames == fMaxFrames && overflowPolicy == fOverflowPolicy;
+  }
+
+  void open(unsigned sessionId); // (re)starts the queue, empty, for the session "sessionId" (just passed to the "queue_drop" probe)
+  void close(); // no more frames will be added; consumers get the remaining frames, then -1
+
+  enum PushResult {
+    QUEUED,
+    DROPPED, // the queue was full (and the policy is RTSPC_FRAMEQUEUE_DROP_NEWEST), or closed
+    BEHIND   // the oldest queued frame was older than "maxAgeUsecs": every queued frame - and this one - was dropped
+  };
+  PushResult push(RTSPClientAttr const& attr, int streamIndex, u_int8_t const* data, unsigned maxAgeUsecs = 0/*no bound*/);
+      // Called by the event loop.
+  int pop(RTSPClientFrame* frame, int timeoutMs);
+      // Returns 0 (and fills in "frame"), 1 if there was no frame within "timeoutMs" (< 0: no limit), or -1 if the queue is
+      // closed (and empty).  Any buffer that "frame" already held is released first.
+  int popAvailable(RTSPClientFrame* frames, unsigned maxFrames);
+      // Without waiting: returns the number of frames (up to "maxFrames") that were queued, or -1 if the queue is closed (and
+      // empty).  Any buffers that "frames[]" already held are released first.
+  int eventFd() const { return fEventFd; } // -1 if it couldn't be created
+  void release(RTSPClientFrame* frame);
+
+  // For statistics (these take no lock, so may be a moment out of date):
+  unsigned numDropped() const { return __atomic_load_n(&fNumDropped, __ATOMIC_RELAXED); } // since "open()"
+  unsigned numQueued() const { return __atomic_load_n(&fNumFrames, __ATOMIC_RELAXED); }
+
+private:
+  struct Buffer {
+    Buffer* next; // in the free list
+    unsigned capacity;
+    // followed by the data
+  };
+  struct Entry {
+    RTSPClientAttr attr;
+    int streamIndex;
+    Buffer* buffer;
+    u_int64_t arrivalUsecs; // CLOCK_MONOTONIC; set only if "push()" was given a latency bound
+  };
+
+  Buffer* takeBuffer(unsigned size); // must be called with "fMutex" locked
+  void freeBuffer(Buffer* buffer); // ditto
+  void releaseLocked(RTSPClientFrame* frame); // ditto
+  void takeEntry(RTSPClientFrame* frame); // ditto; the queue must not be empty
+  void updateEventFd(); // ditto; makes "fEventFd" readable iff the queue has frames, or is closed
+
+private:
+  pthread_mutex_t fMutex;
+  pthread_cond_t fCond;
+  unsigned fMaxFrames;
+  int fOverflowPolicy;
+  Entry* fEntries; // a ring of "fMaxFrames" entries
+  unsigned fHead, fNumFrames;
+  Buffer* fFreeBuffers;
+  Boolean fIsOpen;
+  unsigned fSessionId;
+  unsigned fNumDropped;
+  int fEventFd;
+  Boolean fEventFdIsReadable;
+};
+
+#endif // __RTSPCLIENT_FRAMEQUEUE_H
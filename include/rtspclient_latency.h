@@ -0,0 +1,68 @@
+#ifndef __RTSPCLIENT_LATENCY_H
+#define __RTSPCLIENT_LATENCY_H
+/*
+ * Latency histograms of the frame path.
+ *
+ * Each frame is timestamped (with the monotonic clock) when the RTP packet that completes it was read from its socket (by
+ * "RTSPClientBatchReader"; with io_uring, when the kernel's completion for it was reaped), when live555 hands the frame to the
+ * session's sink, and on entry to and return from the callback that it's passed to.  The differences between these go into
+ * a histogram per stage (RTSPC_LATENCY_*) per session, which "RTSPClientSession::GetLatencyStats()" summarizes as percentiles.
+ *
+ * The histograms are 'HDR'-style: a value is counted in one of 2^RTSPCLIENT_LATENCY_SUB_BUCKET_BITS linear sub-buckets of its
+ * power of 2, i.e., to within 1/16 of itself, from 1 us up to 2^RTSPCLIENT_LATENCY_MAX_BITS us (larger values are counted as
+ * that).  Recording a value costs a count-leading-zeros, a shift and a few increments: only the event loop records values, so
+ * there are no locks or atomic read-modify-writes; a reader (in any thread) just loads the counts.
+ *
+*/
+
+#include "NetCommon.h"
+#include <time.h>
+
+struct RTSPClientLatencyStats; // forward (see "rtspclient_self.h")
+
+#define RTSPCLIENT_LATENCY_SUB_BUCKET_BITS  4
+#define RTSPCLIENT_LATENCY_MAX_BITS         27 // i.e., ~134 s
+#define RTSPCLIENT_LATENCY_BUCKETS \
+  ((RTSPCLIENT_LATENCY_MAX_BITS - RTSPCLIENT_LATENCY_SUB_BUCKET_BITS + 1) << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS)
+
+class RTSPClientLatencyHistogram {
+public:
+  RTSPClientLatencyHistogram() { reset(); }
+
+  static u_int64_t nowUsecs() { // the time that values are measured with
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec*(u_int64_t)1000000 + now.tv_nsec/1000;
+  }
+
+  void record(u_int64_t usecs) { // event loop only
+    unsigned bucket = bucketOf(usecs);
+    __atomic_store_n(&fCounts[bucket], fCounts[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&fSumUsecs, fSumUsecs + usecs, __ATOMIC_RELAXED);
+    if (usecs > fMaxUsecs) __atomic_store_n(&fMaxUsecs, usecs, __ATOMIC_RELAXED);
+  }
+  void recordInterval(u_int64_t startUsecs, u_int64_t endUsecs) {
+    if (startUsecs != 0 && endUsecs >= startUsecs) record(endUsecs - startUsecs); // (0: the start time wasn't known)
+  }
+  void reset(); // event loop only
+  void summarize(RTSPClientLatencyStats& stats) const; // any thread
+
+private:
+  static unsigned bucketOf(u_int64_t usecs) {
+    if (usecs < (1 << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS)) return (unsigned)usecs;
+    if (usecs >= ((u_int64_t)1 << RTSPCLIENT_LATENCY_MAX_BITS)) return RTSPCLIENT_LATENCY_BUCKETS - 1;
+
+    unsigned log2 = 63 - __builtin_clzll(usecs); // >= RTSPCLIENT_LATENCY_SUB_BUCKET_BITS
+    unsigned shift = log2 - RTSPCLIENT_LATENCY_SUB_BUCKET_BITS;
+    return ((shift + 1) << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS)
+      + (unsigned)((usecs >> shift) & ((1 << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS) - 1));
+  }
+  static u_int64_t highestValueIn(unsigned bucket);
+
+private:
+  u_int32_t fCounts[RTSPCLIENT_LATENCY_BUCKETS];
+  u_int64_t fSumUsecs;
+  u_int64_t fMaxUsecs;
+};
+
+#endif // __RTSPCLIENT_LATENCY_H
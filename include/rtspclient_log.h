@@ -0,0 +1,111 @@
+#ifndef __RTSPCLIENT_LOG_H
+#define __RTSPCLIENT_LOG_H
+/*
+ * Leveled, asynchronous logging.
+ *
+ * "RTSPC_LOG()" formats a line into a slot of a lock-free ring (any thread may log; a slot is claimed with one compare-and-swap),
+ * and returns; a background thread writes the lines out - to stderr, or to the application's "RTSPClient_LogCallBack".  So
+ * logging never makes the event loop wait for a write.  If the ring is full, the line is dropped (and counted) rather than
+ * waited for.
+ *
+ * Lines above RTSPCLIENT_LOG_MAX_LEVEL are compiled out altogether (e.g., build with -DRTSPCLIENT_LOG_MAX_LEVEL=5 to have the
+ * per-frame RTSPC_LOG_LEVEL_TRACE lines); lines above the runtime level ("setLevel()") cost only a comparison.
+ *
+ * A session's lines also go through its "RTSPClientLogLimiter" (a token bucket), so that a misbehaving camera (or a
+ * reconnect storm) can't flood the log: the lines over its rate are suppressed, and the next line that's let through says
+ * how many were.
+ *
+ * "RTSPClientUsageEnvironment" turns everything written to the "UsageEnvironment" (i.e., live555's own messages - chiefly
+ * the protocol tracing of the sessions whose verbosity is set) into lines of this log, as well.
+ *
+*/
+
+#include <stdarg.h>
+#include <sys/time.h>
+#include "BasicUsageEnvironment.hh"
+#include "rtspclient_self.h"
+
+#ifndef RTSPCLIENT_LOG_MAX_LEVEL
+#define RTSPCLIENT_LOG_MAX_LEVEL    RTSPC_LOG_LEVEL_DEBUG
+#endif
+
+#define RTSPCLIENT_LOG_LINE_BYTES   256 // longer lines are truncated
+#define RTSPCLIENT_LOG_RING_LINES   1024 // must be a power of 2
+#define RTSPCLIENT_LOG_ENV_LINES_PER_SECOND 200 // a RTSP exchange (e.g., a "DESCRIBE" response with its SDP) is dozens of lines
+
+#define RTSPC_LOG(logLevel, limiter, ...) \
+  do { \
+    if ((logLevel) <= RTSPCLIENT_LOG_MAX_LEVEL && (logLevel) <= RTSPClientLog::level()) \
+      RTSPClientLog::write((logLevel), (limiter), __VA_ARGS__); \
+  } while (0)
+
+class RTSPClientLogLimiter {
+public:
+  RTSPClientLogLimiter(unsigned linesPerSecond = 20, unsigned burstLines = 50);
+
+  Boolean allow(struct timeval const& timeNow);
+  unsigned takeNumSuppressed(); // since the last call
+
+private:
+  unsigned fLinesPerSecond, fBurstLines;
+  unsigned fTokens; // lines that may be logged now
+  struct timeval fLastRefill;
+  unsigned fNumSuppressed;
+};
+
+class RTSPClientLog {
+public:
+  static int level() { return fLevel; }
+  static void setLevel(int level);
+  static void setCallBack(RTSPClient_LogCallBack* callBack, void* callBackData); // NULL: write to stderr
+
+  static void write(int level, RTSPClientLogLimiter* limiter/*may be NULL*/, char const* format, ...)
+    __attribute__((format(printf, 3, 4)));
+  static void vwrite(int level, RTSPClientLogLimiter* limiter, char const* format, va_list args);
+
+  static void flush(); // waits (for up to a second) until the lines logged so far have been written
+  static void stopWriter(); // writes out the lines logged so far, and ends the background thread (the next line starts it again)
+  static unsigned numDropped(); // lines dropped because the ring was full
+
+private:
+  static void* writerThread(void*);
+  static void startWriter();
+  static void wakeWriter();
+  static Boolean writeQueued(); // returns False if there was nothing to write
+
+private:
+  static int fLevel;
+};
+
+// A "UsageEnvironment" whose output goes to the log, rather than to stderr: one line per '\n', at RTSPC_LOG_LEVEL_INFO.  Most of
+// it is the protocol tracing of a "RTSPClient" whose verbosity level is set; live555 doesn't even format that for the others, so
+// tracing one session costs the rest nothing.  (It's rate limited as a whole, with a budget of RTSPCLIENT_LOG_ENV_LINES_PER_SECOND.)
+// Like any "UsageEnvironment", it must be used only by the event loop thread.
+class RTSPClientUsageEnvironment: public BasicUsageEnvironment {
+public:
+  static RTSPClientUsageEnvironment* createNew(TaskScheduler& taskScheduler);
+
+  virtual UsageEnvironment& operator<<(char const* str);
+  virtual UsageEnvironment& operator<<(int i);
+  virtual UsageEnvironment& operator<<(unsigned u);
+  virtual UsageEnvironment& operator<<(double d);
+  virtual UsageEnvironment& operator<<(void* p);
+
+protected:
+  RTSPClientUsageEnvironment(TaskScheduler& taskScheduler);
+      // called only by "createNew()"
+  virtual ~RTSPClientUsageEnvironment();
+
+private:
+  static Boolean isLogging() {
+    return RTSPC_LOG_LEVEL_INFO <= RTSPCLIENT_LOG_MAX_LEVEL && RTSPC_LOG_LEVEL_INFO <= RTSPClientLog::level();
+  }
+  void append(char const* str);
+
+private:
+  char fLine[RTSPCLIENT_LOG_LINE_BYTES];
+  unsigned fLineLength;
+  RTSPClientLogLimiter fLimiter;
+};
+
+#endif // __RTSPCLIENT_LOG_H
@@ -0,0 +1,26 @@
+#ifndef __RTSPCLIENT_PORTPOOL_H
+#define __RTSPCLIENT_PORTPOOL_H
+/*
+ * A pool of client RTP/RTCP port pairs (even RTP port N, RTCP port N+1), taken from a configured range,
+ * for unicast RTP-over-UDP subsessions.
+ *
+ * Allocation and release are O(1) (a FIFO free list of pair indices), so that a just-released pair is
+ * the last one to be handed out again; late packets from the old stream are then unlikely to reach a new one.
+ *
+*/
+
+#include "NetAddress.hh"
+
+class RTSPClientPortPool {
+public:
+  static Boolean setRange(portNumBits firstPortNum, portNumBits lastPortNum);
+      // (Re)configures the pool; fails if the range is invalid, or if any port pair is still in use.
+      // An empty range ("firstPortNum" == 0) disables the pool.
+
+  static portNumBits allocate();
+      // Returns the (even) RTP port number of a free pair, or 0 if the pool is disabled or empty.
+  static void release(portNumBits rtpPortNum);
+      // Returns the pair to the end of the free list.  (Port numbers that we didn't allocate are ignored.)
+};
+
+#endif // __RTSPCLIENT_PORTPOOL_H
@@ -0,0 +1,88 @@
+#ifndef __RTSPCLIENT_REORDER_H
+#define __RTSPCLIENT_REORDER_H
+/*
+ * Reordering of incoming RTP packets, by sequence number.
+ *
+ * live555's "ReorderingPacketBuffer" keeps out-of-order packets in a linked list, sorted by a linear search on
+ * each insert.  RTSPClientReorderRing instead keeps them in a power-of-two ring of slots, indexed by (the low bits
+ * of) the RTP sequence number, so inserting a packet, checking whether the next packet is at the head, and
+ * skipping a gap are all O(1) (a gap costs O(its length), once).
+ *
+ * It is used (by "RTSPClientBatchReader") before the packets reach live555, which then sees them in order, and
+ * has its own reordering threshold set to 0.  A packet that's missing is given up for lost once the ring has
+ * waited "thresholdUsecs" for it (or once the ring is full).
+ *
+*/
+
+#include "NetCommon.h"
+#include "Boolean.hh"
+#include <sys/time.h>
+#include <netinet/in.h>
+
+#define RTSPCLIENT_REORDER_SLOT_BYTES  2048 // larger packets are never held (they're passed on as they arrive)
+
+class RTSPClientReorderRing {
+public:
+  RTSPClientReorderRing(unsigned log2NumSlots, unsigned thresholdUsecs, unsigned sessionId = 0, int streamIndex = 0);
+      // "sessionId" and "streamIndex" (of the stream whose packets we reorder) are just passed to the "packet_lost" probe.
+  virtual ~RTSPClientReorderRing();
+
+  enum InsertResult {
+    DELIVER_NOW, // the packet is the next one expected (and nothing is held); pass it on as is
+    HELD,        // the packet has been copied into the ring
+    DISCARDED    // the packet is a duplicate, or arrived after we'd given up waiting for it
+  };
+  InsertResult insert(u_int8_t const* packet, unsigned packetSize, struct sockaddr_in const& fromAddress,
+                      struct timeval const& timeNow, u_int64_t arrivalUsecs = 0);
+      // "packet" must be a RTP packet (at least 12 bytes long).  "arrivalUsecs" (when it was read) is just kept with it.
+
+  Boolean hasDeliverable(struct timeval const& timeNow) const;
+  unsigned deliverNext(u_int8_t* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress,
+                       struct timeval const& timeNow, u_int64_t* arrivalUsecs = NULL);
+      // Copies out the next packet (skipping a gap, if we've waited long enough for it); returns its size,
+      // or 0 if nothing is deliverable.
+  unsigned usecsUntilDeadline(struct timeval const& timeNow) const;
+      // Returns how long until we give up on the missing head packet (~0 if we're not waiting for one).
+
+  unsigned thresholdUsecs() const { return fThresholdUsecs; }
+  void setThresholdUsecs(unsigned thresholdUsecs) { fThresholdUsecs = thresholdUsecs; }
+
+  unsigned numPacketsHeld() const { return fNumHeld; }
+  unsigned numPacketsReordered() const { return fNumReordered; } // packets held (behind a missing one), then passed on
+  unsigned numPacketsSkipped() const { return fNumSkipped; } // packets given up for lost
+  unsigned numPacketsDiscarded() const { return fNumDiscarded; } // duplicates and late packets
+  unsigned numPacketsLate() const { return fNumLate; } // packets that arrived after we'd given up waiting for them
+
+private:
+  void startWaiting(struct timeval const& timeNow);
+  void skipToNextHeld();
+
+private:
+  unsigned fNumSlots; // a power of 2
+  u_int16_t fSlotMask;
+  unsigned fThresholdUsecs;
+  unsigned fSessionId;
+  int fStreamIndex;
+
+  struct Slot {
+    Boolean used;
+    Boolean skipped; // we gave up waiting for the packet "seqNum"
+    u_int16_t seqNum;
+    unsigned size;
+    struct sockaddr_in fromAddress;
+    u_int64_t arrivalUsecs;
+    u_int8_t* data; // allocated when the slot is first used
+  };
+  Slot* fSlots;
+  Slot fSpill; // a packet (far outside the ring's window) to pass on once the ring has been flushed
+
+  Boolean fHaveSeqNum;
+  u_int16_t fNextSeqNum; // the sequence number of the next packet to pass on
+  unsigned fNumHeld;
+  Boolean fFlushing; // we're passing on all held packets (skipping gaps), and then "fSpill"
+  struct timeval fWaitStart; // when we started waiting for the (missing) head packet
+
+  unsigned fNumReordered, fNumSkipped, fNumDiscarded, fNumLate;
+};
+
+#endif // __RTSPCLIENT_REORDER_H
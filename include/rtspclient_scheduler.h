@@ -0,0 +1,175 @@
+#ifndef __RTSPCLIENT_SCHEDULER_H
+#define __RTSPCLIENT_SCHEDULER_H
+/*
+ * The task scheduler used by RTSPClientSession.
+ *
+ * It behaves like "BasicTaskScheduler", except that - before each "select()" - it first calls the read handlers
+ * of sockets that still have packets (or stream data) cached by "RTSPClientBatchReader" (see "rtspclient_batch.h").
+ * A batch of packets read by one "recvmmsg()" - or a chunk of RTP-over-TCP data read by one "recv()" - is therefore
+ * delivered without a "select()" (and a "readSocket()" system call) per packet.
+ *
+ * Optionally ("wakeUpOnTrigger"), "triggerEvent()" (which may be called from any thread) also wakes up the event loop at
+ * once, through an eventfd that's in the "select()" set.  The loop then no longer needs to poll for triggered events
+ * every "maxSchedulerGranularity", so it's created with a granularity of 0: when idle, it sleeps until a socket, a timer or
+ * a trigger needs it.
+ *
+ * Optionally ("useIOUring"), it waits on an io_uring (see "rtspclient_uring.h") instead of "select()": the packets of batched
+ * RTP-over-UDP sockets are then received by the kernel, into a shared buffer pool, without any system call of ours.  (If the
+ * kernel can't do this, we use "select()" as usual.)  Every socket that's found ready has its handler called in the same step.
+ *
+ * Optionally ("enableProfiling()"), it times every handler call, by type - media sockets, RTSP connections, timers and triggered
+ * events - and attributes it to the "RTSPClientLoopUsage" (e.g., of a session) that owns the socket (or that the handler names with
+ * "setCurrentOwner()"), as well as the time that it spends waiting, and how late a periodic 'probe' timer fires (the loop's 'lag').
+ * A handler call that takes longer than a threshold (a 'stall') is reported once it returns.  (Profiling with "select()" uses our own
+ * copy of "BasicTaskScheduler::SingleStep()", so that the wait can be told apart from the handler calls.)
+ *
+*/
+
+#include "BasicUsageEnvironment.hh"
+#include "rtspclient_uring.h"
+#include "rtspclient_latency.h"
+
+// How often the event loop's 'lag' is measured, when profiling:
+#define RTSPCLIENT_LOOP_LAG_PROBE_USECS 50000
+
+class RTSPClientLoopUsage; // forward
+
+class RTSPClientTaskScheduler: public BasicTaskScheduler {
+public:
+  static RTSPClientTaskScheduler* createNew(unsigned maxSchedulerGranularity = 10000/*microseconds*/,
+                                            Boolean wakeUpOnTrigger = False, Boolean useIOUring = False);
+      // If "wakeUpOnTrigger" is True (and an eventfd can be created), "maxSchedulerGranularity" is ignored.
+      // "useIOUring" implies "wakeUpOnTrigger" (if io_uring is available).
+  virtual ~RTSPClientTaskScheduler();
+
+  void wakeUp();
+      // Makes the event loop return from "select()" (if it's waiting there) - e.g., after another thread has set its
+      // 'watch variable'.  May be called from any thread.  (Does nothing unless "wakeUpOnTrigger" was True.)
+
+  Boolean usesIOUring() const { return fUring != NULL; }
+
+  enum HandlerType { MEDIA_HANDLER, RTSP_HANDLER, TIMER_HANDLER, TRIGGER_HANDLER, NUM_HANDLER_TYPES };
+      // (in the order of the RTSPC_LOOP_HANDLER_* types)
+  typedef void StallHandlerProc(void* clientData, RTSPClientLoopUsage* owner, HandlerType type, int socketNum, u_int64_t usecs);
+      // "owner" is NULL if the handler call was attributed to no-one; "socketNum" is -1 for a timer or a triggered event
+
+  void enableProfiling(unsigned stallThresholdUsecs = 0, StallHandlerProc* stallHandler = NULL, void* stallHandlerClientData = NULL);
+      // From now on, time every handler call (and wait); a call that takes at least "stallThresholdUsecs" (0: none) is passed to
+      // "stallHandler" after it returns.  Event loop (or before it runs) only.
+  Boolean isProfiling() const { return fProfiling; }
+
+  void setSocketOwner(int socketNum, RTSPClientLoopUsage* owner, HandlerType type);
+      // Attributes the socket's handler calls (of "type") to "owner" (NULL: to no-one; a socket's handler calls are RTSP_HANDLER
+      // calls of no-one unless set).  Event loop only.
+  void setCurrentOwner(RTSPClientLoopUsage* owner) { fCurrentOwner = owner; }
+      // Attributes the handler call that's in progress to "owner" instead (e.g., from a timer's handler)
+  void forgetOwner(RTSPClientLoopUsage* owner);
+      // Must be called (by the event loop) before "owner" is deleted
+
+  RTSPClientLoopUsage const& totalUsage() const { return *fTotalUsage; } // of all handler calls
+  u_int64_t waitUsecs() const { return __atomic_load_n(&fWaitUsecs, __ATOMIC_RELAXED); }
+  RTSPClientLatencyHistogram const& lag() const { return fLag; } // how late each lag probe fired
+      // (These may be read from any thread.)
+
+  void step(unsigned maxDelayTime) { SingleStep(maxDelayTime == 0 ? 1 : maxDelayTime); }
+      // Runs one step of the event loop, waiting (for a socket, a timer or a trigger) for up to "maxDelayTime" microseconds
+      // (0: not at all).  For an application that drives the event loop itself, rather than calling "doEventLoop()".
+
+  // Redefined virtual functions:
+  virtual void triggerEvent(EventTriggerId eventTriggerId, void* clientData = NULL);
+
+protected:
+  RTSPClientTaskScheduler(unsigned maxSchedulerGranularity, int wakeUpFd, RTSPClientUring* uring);
+      // called only by "createNew()"
+
+protected:
+  // Redefined virtual functions:
+  virtual void SingleStep(unsigned maxDelayTime);
+
+  virtual void setBackgroundHandling(int socketNum, int conditionSet, BackgroundHandlerProc* handlerProc, void* clientData);
+  virtual void moveSocketHandling(int oldSocketNum, int newSocketNum);
+
+private:
+  unsigned handlePendingPackets(); // returns the number of handler calls made
+  void selectSingleStep(unsigned maxDelayTime); // when profiling
+  void uringSingleStep(unsigned maxDelayTime);
+  void handleTriggeredEvents();
+  void callTriggeredEventHandler(unsigned triggerNum);
+  void handleAlarm();
+
+  void callSocketHandler(int socketNum, int resultConditionSet);
+  void addHandledSocket(int socketNum);
+  void removeHandledSocket(int socketNum);
+  void startCall(HandlerType type, RTSPClientLoopUsage* owner);
+  void endCall(int socketNum);
+  void addWait(u_int64_t startUsecs);
+
+  static void wakeUpHandler(void* clientData, int mask);
+  static void lagProbeHandler(void* clientData);
+
+private:
+  // Our own copy of each socket's handler (live555's "HandlerSet" doesn't let us look one up):
+  struct SocketHandler {
+    int conditionSet;
+    BackgroundHandlerProc* proc;
+    void* clientData;
+    unsigned index; // of the socket in "fHandledSockets" (if "proc" is set)
+  };
+  SocketHandler fSocketHandlers[FD_SETSIZE];
+  int fHandledSockets[FD_SETSIZE]; // the sockets that have a handler (in no order), so that a step needn't look at every slot
+  unsigned fNumHandledSockets;
+
+  int fWakeUpFd; // an eventfd; -1 if none
+  RTSPClientUring* fUring; // NULL if we use "select()"
+  RTSPClientUring::Readiness fReadiness[FD_SETSIZE];
+
+  // Profiling:
+  struct SocketOwner {
+    RTSPClientLoopUsage* usage;
+    HandlerType type;
+  };
+  SocketOwner fSocketOwners[FD_SETSIZE];
+  Boolean fProfiling;
+  unsigned fStallThresholdUsecs;
+  StallHandlerProc* fStallHandler;
+  void* fStallHandlerClientData;
+  RTSPClientLoopUsage* fTotalUsage;
+  RTSPClientLoopUsage* fCurrentOwner; // of the handler call in progress
+  HandlerType fCurrentType;
+  u_int64_t fCallStartUsecs;
+  u_int64_t fWaitUsecs;
+  RTSPClientLatencyHistogram fLag;
+  u_int64_t fLagProbeDueUsecs;
+};
+
+// The time that the event loop has spent in handler calls on behalf of something (e.g., a session).  Only the event loop updates it,
+// but it may be read from any thread:
+class RTSPClientLoopUsage {
+public:
+  RTSPClientLoopUsage(void* owner = NULL);
+
+  void* owner() const { return fOwner; }
+  void setOwner(void* owner) { fOwner = owner; }
+  void reset(void* owner); // zeroes it, for a new owner
+
+  void add(RTSPClientTaskScheduler::HandlerType type, u_int64_t usecs) {
+    __atomic_store_n(&fUsecs[type], fUsecs[type] + usecs, __ATOMIC_RELAXED);
+    __atomic_store_n(&fCalls[type], fCalls[type] + 1, __ATOMIC_RELAXED);
+    if (usecs > fMaxUsecs[type]) __atomic_store_n(&fMaxUsecs[type], usecs, __ATOMIC_RELAXED);
+  }
+  void addStall() { __atomic_store_n(&fStalls, fStalls + 1, __ATOMIC_RELAXED); }
+
+  u_int64_t usecs(unsigned type) const { return __atomic_load_n(&fUsecs[type], __ATOMIC_RELAXED); }
+  u_int64_t calls(unsigned type) const { return __atomic_load_n(&fCalls[type], __ATOMIC_RELAXED); }
+  u_int64_t maxUsecs(unsigned type) const { return __atomic_load_n(&fMaxUsecs[type], __ATOMIC_RELAXED); }
+  u_int64_t stalls() const { return __atomic_load_n(&fStalls, __ATOMIC_RELAXED); }
+
+private:
+  void* fOwner;
+  u_int64_t fUsecs[RTSPClientTaskScheduler::NUM_HANDLER_TYPES];
+  u_int64_t fCalls[RTSPClientTaskScheduler::NUM_HANDLER_TYPES];
+  u_int64_t fMaxUsecs[RTSPClientTaskScheduler::NUM_HANDLER_TYPES];
+  u_int64_t fStalls;
+};
+
+#endif // __RTSPCLIENT_SCHEDULER_H
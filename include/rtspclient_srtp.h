@@ -0,0 +1,67 @@
+#ifndef __RTSPCLIENT_SRTP_H
+#define __RTSPCLIENT_SRTP_H
+/*
+ * SRTP reception (the "SRTP_AES128_CM_HMAC_SHA1_80" ciphersuite, keyed by MIKEY).
+ *
+ * live555's own "SRTPCryptographicContext" encrypts one AES block per call, and sets up the HMAC
+ * from scratch for each packet.  RTSPClientSRTPContext does the same job with OpenSSL EVP contexts
+ * that are keyed once, so AES-CTR runs over a whole packet (using AES-NI/ARMv8 crypto instructions
+ * where the CPU has them), and HMAC-SHA1 restarts from the precomputed key state.
+ *
+ * It is installed as the RTP source's "auxilliary read handler" (so it sees each packet straight
+ * after it has been read), in place of the RTP source's "SRTPCryptographicContext".  SRTCP is
+ * still handled by live555 (including SRTCP packets muxed on the RTP socket, which we pass over),
+ * and so is SRTP over TCP: live555 calls the handler with just the bytes of each read, which
+ * needn't be a whole packet.
+ *
+*/
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "liveMedia.hh"
+
+class RTSPClientSRTPContext {
+public:
+  static RTSPClientSRTPContext* createNew(UsageEnvironment& env, MIKEYState const& mikeyState);
+  virtual ~RTSPClientSRTPContext();
+
+  static void installOn(RTPSource* rtpSource, RTSPClientSRTPContext* srtpContext);
+      // Makes "rtpSource" (which must be receiving over UDP) use "srtpContext" (rather than live555's
+      // "SRTPCryptographicContext") for incoming SRTP packets.  "srtpContext" == NULL uninstalls it.
+
+  Boolean processIncomingSRTPPacket(u_int8_t* buffer, unsigned inPacketSize, unsigned& outPacketSize);
+      // Authenticates (if necessary) and decrypts (if necessary) - in place - an incoming SRTP packet.
+      // Returns True iff the packet is well-formed and authenticates OK.
+
+  unsigned numPacketsDropped() const { return fNumPacketsDropped; } // that failed authentication, or were malformed
+
+private:
+  RTSPClientSRTPContext(UsageEnvironment& env, MIKEYState const& mikeyState);
+    // called only by "createNew()"
+
+  Boolean deriveKeys(u_int8_t const* masterKeyPlusSalt);
+
+  static void auxReadHandler(void* clientData, unsigned char* packet, unsigned& packetSize);
+
+private:
+  UsageEnvironment& fEnv;
+  Boolean fEncrypt;
+  Boolean fAuthenticate;
+  unsigned fTrailerSize; // MKI + authentication tag
+
+  EVP_CIPHER_CTX* fCipherCtx; // AES-128-CTR, keyed with the session key
+  u_int8_t fSessionSalt[14];
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  HMAC_CTX fHMACCtxStorage;
+#endif
+  HMAC_CTX* fHMACCtx; // keyed with the session authentication key
+
+  // State used for estimating each packet's index (RFC 3711, section 3.3.1):
+  Boolean fHaveReceivedSRTPPackets;
+  u_int16_t fHighestSeqNum;
+  u_int32_t fROC; // rollover counter
+
+  unsigned fNumPacketsDropped;
+};
+
+#endif // __RTSPCLIENT_SRTP_H
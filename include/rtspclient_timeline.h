@@ -0,0 +1,64 @@
+#ifndef __RTSPCLIENT_TIMELINE_H
+#define __RTSPCLIENT_TIMELINE_H
+/*
+ * The timeline of a session's startup: when each of its phases (RTSPC_PHASE_*) - resolving the server's address, connecting to it,
+ * "DESCRIBE", each "SETUP", "PLAY", and then the first RTP packet, keyframe and frame handed to the application - began and ended.
+ *
+ * The times are taken (with "RTSPClientLatencyHistogram::nowUsecs()") by the event loop, as the session goes through each phase;
+ * only the first time counts (e.g., not again when the stream is restarted over TCP).  "get()" - which any thread may call -
+ * makes them relative to the session's start.
+ *
+ * Optionally ("openTraceFile()"), each session's timeline is also written - once its first keyframe and first frame have both
+ * been handed over, or else when it ends - to a file in the Chrome 'trace event' (JSON array) format, which "chrome://tracing"
+ * and Perfetto can show: one row per session (with all sessions on the same time axis), with a 'complete' event for each phase
+ * and an 'instant' event for each "first".  The file is valid JSON once it's closed; until then, these viewers still load it.
+ *
+*/
+
+#include "NetCommon.h"
+#include "Boolean.hh"
+
+struct RTSPClientStartupTimeline; // forward (see "rtspclient_self.h")
+
+#define RTSPCLIENT_TIMELINE_PHASES      8 // RTSPC_PHASES
+#define RTSPCLIENT_TIMELINE_MAX_SETUPS  8 // RTSPC_MAX_SETUPS
+
+class RTSPClientTimeline {
+public:
+  RTSPClientTimeline(); // the session (and its first phase) starts now
+  void reset(); // ditto, forgetting the previous startup (and whether it was traced); by the event loop only
+
+  void setStartUsecs(u_int64_t startUsecs) { __atomic_store_n(&fStartUsecs, startUsecs, __ATOMIC_RELAXED); }
+      // e.g., when the application asked for the session (before the event loop got to it)
+
+  // These are called by the event loop only:
+  void begin(unsigned phase, u_int64_t usecs = 0/*now*/);
+      // Beginning RTSPC_PHASE_PLAY also begins the phases that wait for the first RTP packet, keyframe and frame
+  void end(unsigned phase, u_int64_t usecs = 0/*now*/);
+  Boolean hasEnded(unsigned phase) const { return fEndUsecs[phase] != 0; }
+  void beginSetup(); // a "SETUP" was sent (before "PLAY"): also begins RTSPC_PHASE_SETUP
+  void endSetup(); // its response arrived: also (re-)ends RTSPC_PHASE_SETUP
+
+  void get(RTSPClientStartupTimeline& timeline) const; // any thread
+
+  void writeTrace(unsigned sessionId, char const* url);
+      // If a trace file is open - and we haven't already - writes the timeline to it
+
+  static Boolean openTraceFile(char const* path); // any thread; closes the current trace file (if any) first
+  static void closeTraceFile(); // any thread
+
+private:
+  static void storeOnce(u_int64_t& field, u_int64_t usecs);
+  u_int64_t startUsecs() const { return __atomic_load_n(&fStartUsecs, __ATOMIC_RELAXED); }
+
+private:
+  u_int64_t fStartUsecs;
+  u_int64_t fBeginUsecs[RTSPCLIENT_TIMELINE_PHASES];
+  u_int64_t fEndUsecs[RTSPCLIENT_TIMELINE_PHASES]; // 0: not (yet) ended
+  unsigned fNumSetups;
+  u_int64_t fSetupBeginUsecs[RTSPCLIENT_TIMELINE_MAX_SETUPS];
+  u_int64_t fSetupEndUsecs[RTSPCLIENT_TIMELINE_MAX_SETUPS];
+  Boolean fTraced;
+};
+
+#endif // __RTSPCLIENT_TIMELINE_H
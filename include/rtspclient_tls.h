@@ -0,0 +1,64 @@
+#ifndef __RTSPCLIENT_TLS_H
+#define __RTSPCLIENT_TLS_H
+/*
+ * "rtsps://" support: RTSP (and interleaved RTP) over TLS, with TLS session resumption.
+ *
+ * RTSPClient talks plain RTSP over a (UNIX-domain) socket pair to a RTSPClientTLSConnection,
+ * which relays it over a TLS connection to the server.  TLS sessions (session IDs or
+ * session tickets) are cached per server, so that reconnects do an abbreviated handshake.
+ *
+*/
+
+#include <openssl/ssl.h>
+#include "rtspclient_self.h"
+
+#define RTSPCLIENT_TLS_DEFAULT_PORT     322
+
+class RTSPClientTLSConnection {
+public:
+  static char* convertRTSPSURL(char const* url, char*& serverName);
+      // Returns (as new[]-allocated strings) the equivalent "rtsp://" URL - with an explicit port number -
+      // and the server's host name.  Returns NULL if "url" is not a "rtsps://" URL.
+
+  static RTSPClientTLSConnection* createNew(UsageEnvironment& env, int socketNum, Boolean isConnected,
+                                            portNumBits serverPortNum, char const* serverName, char const* caFile);
+      // Takes over the "RTSPClient"'s TCP connection (connected, or still connecting) to the server, and replaces its socket
+      // "socketNum" with one end of a socket pair, whose other end we relay (over TLS) to the server.  The relay then runs
+      // on its own, and deletes itself when either side closes.  Returns NULL (leaving "socketNum" as it was) on failure.
+  virtual ~RTSPClientTLSConnection();
+
+  static void getStats(RTSPClientTLSStats* stats);
+  static void flushSessionCache();
+
+private:
+  RTSPClientTLSConnection(UsageEnvironment& env, int serverSocketNum, char const* serverName, char const* sessionKey);
+
+  Boolean setupTLS(char const* caFile);
+  static void connectionHandler(void* clientData, int mask);
+  static void incomingHandler(void* clientData, int mask);
+  void handleIO();
+  Boolean doHandshake(int& serverConditionSet);
+  Boolean doRelay(int& serverConditionSet, int& localConditionSet);
+
+  static int newSessionCallback(SSL* con, SSL_SESSION* session);
+
+private:
+  UsageEnvironment& fEnv;
+  int fServerSocketNum;
+  int fLocalSocketNum; // our end of the socket pair
+  char* fServerName;
+  char* fSessionKey; // "<server name>:<port>"; the key of our entry in the session cache
+  Boolean fIsConnected;
+  Boolean fHandshakeIsDone;
+  SSL* fCon;
+  unsigned long long fHandshakeCPUUs;
+
+  // Data read from the local socket, waiting to be written over TLS:
+  u_int8_t fToServer[16384];
+  unsigned fToServerHead, fToServerTail;
+  // Data read over TLS, waiting to be written to the local socket:
+  u_int8_t fToLocal[16384];
+  unsigned fToLocalHead, fToLocalTail;
+};
+
+#endif // __RTSPCLIENT_TLS_H
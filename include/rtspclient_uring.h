@@ -0,0 +1,100 @@
+#ifndef __RTSPCLIENT_URING_H
+#define __RTSPCLIENT_URING_H
+/*
+ * An io_uring instance that "RTSPClientTaskScheduler" waits on in place of "select()".
+ *
+ * Every RTP-over-UDP socket that "RTSPClientBatchReader" batches has a multishot "recvmsg()" kept armed on it.  The
+ * kernel puts each datagram straight into a buffer taken from a pool that's shared with it (a 'provided buffer ring'),
+ * and posts a completion; our "readSocket()" then copies the packet out of the pool buffer, and gives the buffer back.
+ * So a RTP packet costs no system call at all - neither a readiness notification nor a read - just a share of the
+ * "io_uring_enter()" that the event loop makes anyway.
+ *
+ * Every other socket (the RTSP connection, RTCP, ...) has a one-shot poll armed on it, which the scheduler re-arms after
+ * calling its handler, so readiness is level-triggered, as with "select()".  The scheduler's timers are the timeout of that
+ * same "io_uring_enter()".
+ *
+ * We use the raw system calls (not liburing).  "createNew()" returns NULL - and the scheduler keeps using "select()" -
+ * if the kernel (or its headers, at build time) lack any of the features that we need (Linux 6.0 or later).
+ *
+*/
+
+#include "NetCommon.h"
+#include "Boolean.hh"
+
+struct io_uring_sqe; // forward
+
+#define RTSPCLIENT_URING_NUM_BUFFERS    512 // pool buffers (shared by all sockets); must be a power of 2
+#define RTSPCLIENT_URING_BUFFER_BYTES   2048 // payload bytes per pool buffer; larger datagrams make us stop using io_uring on that socket
+
+class RTSPClientUring {
+public:
+  static RTSPClientUring* createNew();
+  virtual ~RTSPClientUring();
+
+  static RTSPClientUring* current() { return fCurrent; }
+      // The instance that "RTSPClientBatchReader" uses: the one that was created last (and not yet deleted); NULL if none.
+
+  // Readiness polling (for sockets that aren't "receiving"):
+  void armPoll(int socketNum, int conditionSet); // "conditionSet": as for "TaskScheduler::setBackgroundHandling()"
+  void cancelPoll(int socketNum); // also makes any readiness of "socketNum" that "wait()" has already returned stale
+  Boolean isPollArmed(int socketNum) const;
+  unsigned pollGeneration(int socketNum) const;
+
+  // Multishot reception (for RTP-over-UDP sockets):
+  Boolean startReceiving(int socketNum);
+  void stopReceiving(int socketNum); // must be called before the socket is closed; drops any packets not yet read
+  Boolean isReceiving(int socketNum) const;
+      // Becomes False (by itself) if the kernel can't do this for the socket, or a datagram was too large for a pool buffer.
+  Boolean hasPackets(int socketNum) const;
+  int readPacket(int socketNum, unsigned char* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress);
+      // Returns the size of the next received packet (copied to "buffer"), or 0 if there's none.
+
+  struct Readiness {
+    int socketNum;
+    int conditionSet;
+    unsigned generation; // the socket's "pollGeneration()" at the time
+  };
+  unsigned wait(long timeoutUsecs, Readiness* readiness, unsigned maxReadiness);
+      // Submits our queued requests, waits for a completion for up to "timeoutUsecs" (forever if < 0; not at all if 0), then
+      // handles every completion that has been posted.  Fills in the sockets that polls found ready, and returns their number.
+      // (Received packets are queued, for "readPacket()".)
+  u_int64_t completionUsecs() const { return fCompletionUsecs; }
+      // When (by "RTSPClientLatencyHistogram::nowUsecs()") "wait()" last found completions; i.e., roughly when the packets that
+      // "readPacket()" returns were received.
+
+private:
+  RTSPClientUring();
+      // called only by "createNew()"
+
+  Boolean setUp();
+
+  struct io_uring_sqe* getSQE(); // NULL if the submission queue is full (even after submitting it)
+  void queueSQE();
+  void queueCancel(u_int8_t opcode, u_int64_t userData);
+  void returnBuffer(unsigned short bufferId); // to the pool
+
+  struct ReceiveState; // forward
+  void armReceive(ReceiveState* state);
+  void deleteDetached(ReceiveState* state);
+
+private:
+  static RTSPClientUring* fCurrent;
+
+  struct Rings; // our view of the shared ring memory
+  Rings* fRings;
+  int fRingFd;
+
+  struct SocketState {
+    unsigned pollGeneration;
+    Boolean pollArmed;
+    int pollConditionSet;
+    ReceiveState* receiveState; // NULL unless "startReceiving()" was called (and succeeded)
+  };
+  SocketState fSockets[FD_SETSIZE];
+  ReceiveState* fDetachedStates; // those whose final completion hasn't yet arrived (a list)
+  unsigned fNumReceivingSockets;
+  Boolean fMustRearmReceives; // a multishot receive stopped because the pool ran out of buffers
+  u_int64_t fCompletionUsecs;
+};
+
+#endif // __RTSPCLIENT_URING_H
@@ -0,0 +1,54 @@
+#ifndef __RTSPCLIENT_USDT_H
+#define __RTSPCLIENT_USDT_H
+/*
+ * Static tracepoints (USDT probes, of the provider "rtspclient") on the frame and control paths, for bpftrace, perf or
+ * SystemTap to attach to at run time - e.g., "bpftrace -l 'usdt:lib/librtspclient.so:rtspclient:*'" lists them, and the scripts
+ * in "tools/" use them.
+ *
+ * They're built in only with -DRTSPCLIENT_USDT ("make USDT=1"), which needs <sys/sdt.h> (e.g., from "systemtap-sdt-dev");
+ * otherwise - or without that header - "RTSPCLIENT_PROBE*()" expand to nothing, and their arguments aren't evaluated.  A
+ * built-in probe is a single "nop" (plus the evaluation of its arguments) until a tracer attaches to it.
+ *
+ * The probes (with their arguments, in order):
+ *   frame           session id, stream index, frame size, truncated bytes, arrival time, frame time
+ *                   - a frame was received (before it's handed over);
+ *   frame_done      session id, stream index, arrival time, frame time, time handed over
+ *                   - the callback returned (or the frame was queued, or batched);
+ *   describe        session id, result code, URL
+ *   setup           session id, result code, medium name, codec name, RTP socket (-1 if over TCP)
+ *   play            session id, result code
+ *   shutdown        session id, exit code
+ *   loss            session id, stream index, packets expected, packets lost, kernel drops (totals, once per stats interval)
+ *   packet_lost     session id, stream index, RTP sequence number, wait threshold
+ *                   - the reordering ring gave up waiting for the packet;
+ *   queue_drop      session id, stream index, frames dropped, reason (0: behind, 1: full, 2: full (oldest dropped), 3: no memory)
+ *   pool_exhausted  free buffers - the io_uring buffer pool ran out, so receiving waits for buffers to be given back
+ * Times are in microseconds, by "RTSPClientLatencyHistogram::nowUsecs()" (0: not known); session ids are as in
+ * "RTSPClientStartupTimeline".
+ *
+*/
+
+#if defined(RTSPCLIENT_USDT) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define RTSPCLIENT_HAVE_USDT 1
+#endif
+#endif
+
+#ifdef RTSPCLIENT_HAVE_USDT
+#define RTSPCLIENT_PROBE1(name, a1)                          DTRACE_PROBE1(rtspclient, name, a1)
+#define RTSPCLIENT_PROBE2(name, a1, a2)                      DTRACE_PROBE2(rtspclient, name, a1, a2)
+#define RTSPCLIENT_PROBE3(name, a1, a2, a3)                  DTRACE_PROBE3(rtspclient, name, a1, a2, a3)
+#define RTSPCLIENT_PROBE4(name, a1, a2, a3, a4)              DTRACE_PROBE4(rtspclient, name, a1, a2, a3, a4)
+#define RTSPCLIENT_PROBE5(name, a1, a2, a3, a4, a5)          DTRACE_PROBE5(rtspclient, name, a1, a2, a3, a4, a5)
+#define RTSPCLIENT_PROBE6(name, a1, a2, a3, a4, a5, a6)      DTRACE_PROBE6(rtspclient, name, a1, a2, a3, a4, a5, a6)
+#else
+#define RTSPCLIENT_PROBE1(name, a1)                          do {} while (0)
+#define RTSPCLIENT_PROBE2(name, a1, a2)                      do {} while (0)
+#define RTSPCLIENT_PROBE3(name, a1, a2, a3)                  do {} while (0)
+#define RTSPCLIENT_PROBE4(name, a1, a2, a3, a4)              do {} while (0)
+#define RTSPCLIENT_PROBE5(name, a1, a2, a3, a4, a5)          do {} while (0)
+#define RTSPCLIENT_PROBE6(name, a1, a2, a3, a4, a5, a6)      do {} while (0)
+#endif
+
+#endif // __RTSPCLIENT_USDT_H
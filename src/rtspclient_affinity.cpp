@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "rtspclient_affinity.h"
+
+/*
+ * add 20261019
+ *
+ * Placement of the event loop thread (see "rtspclient_affinity.h").
+ *
+*/
+
+#define RTSPC_MPOL_PREFERRED  1 // from <numaif.h>; we call "set_mempolicy()" directly, so as not to need libnuma
+#define RTSPC_MAX_NUMA_NODES  64
+
+Boolean RTSPClientThreadPlacement::parseCPUList(char const* cpuList, cpu_set_t& cpuSet) {
+  CPU_ZERO(&cpuSet);
+  if (cpuList == NULL) return False;
+
+  char const* p = cpuList;
+  while (*p != '\0') {
+    char* end;
+    long first = strtol(p, &end, 10);
+    if (end == p || first < 0) return False;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      ++p;
+      last = strtol(p, &end, 10);
+      if (end == p || last < first) return False;
+      p = end;
+    }
+    if (last >= CPU_SETSIZE) return False;
+    for (long cpu = first; cpu <= last; ++cpu) CPU_SET(cpu, &cpuSet);
+
+    if (*p == ',') ++p;
+    else if (*p != '\0') return False;
+  }
+
+  return CPU_COUNT(&cpuSet) > 0;
+}
+
+Boolean RTSPClientThreadPlacement::getNodeCPUs(int node, cpu_set_t& cpuSet) {
+  CPU_ZERO(&cpuSet);
+  if (node < 0 || node >= RTSPC_MAX_NUMA_NODES) return False;
+
+  char path[64];
+  snprintf(path, sizeof path, "/sys/devices/system/node/node%d/cpulist", node);
+  FILE* fid = fopen(path, "r");
+  if (fid == NULL) return False;
+
+  char cpuList[256];
+  Boolean result = fgets(cpuList, sizeof cpuList, fid) != NULL;
+  fclose(fid);
+  if (!result) return False;
+
+  cpuList[strcspn(cpuList, "\n")] = '\0';
+  return parseCPUList(cpuList, cpuSet);
+}
+
+Boolean RTSPClientThreadPlacement::setAttributes(pthread_attr_t* attr, char const* cpuList, int node,
+                                                 int policy, int priority) {
+  cpu_set_t cpuSet;
+  if (cpuList != NULL && cpuList[0] != '\0') {
+    if (!parseCPUList(cpuList, cpuSet)) return False;
+    if (pthread_attr_setaffinity_np(attr, sizeof cpuSet, &cpuSet) != 0) return False;
+  } else if (node >= 0) {
+    if (!getNodeCPUs(node, cpuSet)) return False;
+    if (pthread_attr_setaffinity_np(attr, sizeof cpuSet, &cpuSet) != 0) return False;
+  }
+
+  if (policy != SCHED_OTHER) {
+    if (policy != SCHED_FIFO && policy != SCHED_RR) return False;
+    if (priority < sched_get_priority_min(policy) || priority > sched_get_priority_max(policy)) return False;
+
+    struct sched_param param;
+    memset(&param, 0, sizeof param);
+    param.sched_priority = priority;
+    if (pthread_attr_setinheritsched(attr, PTHREAD_EXPLICIT_SCHED) != 0
+        || pthread_attr_setschedpolicy(attr, policy) != 0
+        || pthread_attr_setschedparam(attr, &param) != 0) {
+      return False;
+    }
+  }
+
+  return True;
+}
+
+Boolean RTSPClientThreadPlacement::preferNode(int node) {
+  if (node < 0 || node >= RTSPC_MAX_NUMA_NODES) return False;
+
+  unsigned const bitsPerWord = 8*sizeof (unsigned long);
+  unsigned long nodeMask[RTSPC_MAX_NUMA_NODES/(8*sizeof (unsigned long))];
+  memset(nodeMask, 0, sizeof nodeMask);
+  nodeMask[node/bitsPerWord] = 1UL << (node%bitsPerWord);
+
+  // (The kernel ignores the last bit of "maxnode", hence the + 1:)
+  return syscall(SYS_set_mempolicy, RTSPC_MPOL_PREFERRED, nodeMask, RTSPC_MAX_NUMA_NODES + 1) == 0;
+}
@@ -0,0 +1,338 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // for "RTLD_NEXT" and "recvmmsg()"
+#endif
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <dlfcn.h>
+#include "UsageEnvironment.hh"
+#include "GroupsockHelper.hh"
+#include "rtspclient_batch.h"
+#include "rtspclient_reorder.h"
+#include "rtspclient_uring.h"
+#include "rtspclient_latency.h"
+
+/*
+ * add 20260617
+ *
+ * Batched reception for RTP-over-UDP sockets, and buffered reception for RTP-over-TCP connections
+ * (see "rtspclient_batch.h").
+ *
+*/
+
+struct BatchState {
+  unsigned numPackets, nextPacket; // cached packets [nextPacket, numPackets) are still to be read
+  Boolean stopBatching; // set once we've seen a datagram too large for a slot
+  Boolean uringReceiving; // the packets are received by the scheduler's io_uring (see "rtspclient_uring.h")
+  RTSPClientReorderRing* reorderRing; // NULL unless "setReordering()" was called
+  u_int64_t arrivalUsecs; // of the packet last returned
+  u_int64_t batchArrivalUsecs; // of the cached packets
+  unsigned packetSizes[RTSPCLIENT_BATCH_SIZE];
+  struct sockaddr_in fromAddresses[RTSPCLIENT_BATCH_SIZE];
+  u_int8_t slots[RTSPCLIENT_BATCH_SIZE][RTSPCLIENT_BATCH_SLOT_BYTES]; // slot 0 is unused: packet 0 goes to the caller
+};
+
+struct StreamState {
+  unsigned numBytes, nextByte; // buffered bytes [nextByte, numBytes) are still to be read
+  struct sockaddr_in fromAddress;
+  u_int64_t arrivalUsecs; // of the buffered bytes
+  u_int8_t buffer[RTSPCLIENT_STREAM_BUFFER_BYTES];
+};
+
+static BatchState* batchStates[FD_SETSIZE]; // indexed by socket number; NULL if not batched
+static StreamState* streamStates[FD_SETSIZE]; // indexed by socket number; NULL if not buffered
+static unsigned numBatchedSockets = 0; // includes buffered stream sockets
+
+#define LIVE555_READSOCKET_SYMBOL "_Z10readSocketR16UsageEnvironmentiPhjR11sockaddr_in"
+
+typedef int ReadSocketFunc(UsageEnvironment& env, int socket, unsigned char* buffer, unsigned bufferSize,
+                           struct sockaddr_in& fromAddress);
+
+static ReadSocketFunc* liveReadSocket() {
+  static ReadSocketFunc* func = NULL;
+  if (func == NULL) func = (ReadSocketFunc*)dlsym(RTLD_NEXT, LIVE555_READSOCKET_SYMBOL);
+  return func;
+}
+
+static Boolean isInterposed() {
+  // Our "readSocket()" is used only if it comes before live555's in the symbol lookup order (which it won't if the
+  // application was linked against "libgroupsock" before "librtspclient"); check this:
+  static int result = -1;
+  if (result < 0) {
+    result = dlsym(RTLD_DEFAULT, LIVE555_READSOCKET_SYMBOL) == (void*)&readSocket && liveReadSocket() != NULL;
+  }
+  return result != 0;
+}
+
+Boolean RTSPClientBatchReader::enable(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || streamStates[socketNum] != NULL) return False;
+  if (batchStates[socketNum] != NULL) return True;
+  if (!isInterposed()) return False;
+
+  BatchState* state = new BatchState;
+  state->numPackets = state->nextPacket = 0;
+  state->stopBatching = False;
+  RTSPClientUring* uring = RTSPClientUring::current();
+  state->uringReceiving = uring != NULL && uring->startReceiving(socketNum);
+  state->reorderRing = NULL;
+  state->arrivalUsecs = state->batchArrivalUsecs = 0;
+  batchStates[socketNum] = state;
+  ++numBatchedSockets;
+  return True;
+}
+
+void RTSPClientBatchReader::disable(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || batchStates[socketNum] == NULL) return;
+
+  RTSPClientUring* uring = RTSPClientUring::current();
+  if (batchStates[socketNum]->uringReceiving && uring != NULL) uring->stopReceiving(socketNum);
+  delete batchStates[socketNum]->reorderRing;
+  delete batchStates[socketNum];
+  batchStates[socketNum] = NULL;
+  --numBatchedSockets;
+}
+
+Boolean RTSPClientBatchReader::setReordering(int socketNum, unsigned thresholdUsecs, unsigned sessionId, int streamIndex) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || batchStates[socketNum] == NULL) return False;
+
+  BatchState* state = batchStates[socketNum];
+  delete state->reorderRing;
+  state->reorderRing = new RTSPClientReorderRing(RTSPCLIENT_REORDER_LOG2_SLOTS, thresholdUsecs, sessionId, streamIndex);
+  return True;
+}
+
+RTSPClientReorderRing* RTSPClientBatchReader::reorderRing(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || batchStates[socketNum] == NULL) return NULL;
+
+  return batchStates[socketNum]->reorderRing;
+}
+
+Boolean RTSPClientBatchReader::enableStream(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || batchStates[socketNum] != NULL) return False;
+  if (streamStates[socketNum] != NULL) return True;
+  if (!isInterposed()) return False;
+
+  StreamState* state = new StreamState;
+  state->numBytes = state->nextByte = 0;
+  memset(&state->fromAddress, 0, sizeof state->fromAddress);
+  state->arrivalUsecs = 0;
+  streamStates[socketNum] = state;
+  ++numBatchedSockets;
+  return True;
+}
+
+void RTSPClientBatchReader::disableStream(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || streamStates[socketNum] == NULL) return;
+
+  delete streamStates[socketNum];
+  streamStates[socketNum] = NULL;
+  --numBatchedSockets;
+}
+
+static Boolean isPending(int socketNum, struct timeval const& timeNow) {
+  BatchState* state = batchStates[socketNum];
+  if (state != NULL) {
+    RTSPClientUring* uring = RTSPClientUring::current();
+    return state->nextPacket < state->numPackets
+      || (state->uringReceiving && uring != NULL && uring->hasPackets(socketNum))
+      || (state->reorderRing != NULL && state->reorderRing->hasDeliverable(timeNow));
+  }
+
+  StreamState* streamState = streamStates[socketNum];
+  return streamState != NULL && streamState->nextByte < streamState->numBytes;
+}
+
+Boolean RTSPClientBatchReader::hasPendingPackets(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE) return False;
+
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  return isPending(socketNum, timeNow);
+}
+
+unsigned RTSPClientBatchReader::pendingSockets(int* socketNums, unsigned maxSocketNums) {
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+
+  unsigned numFound = 0, numChecked = 0;
+  for (int i = 0; i < FD_SETSIZE && numChecked < numBatchedSockets && numFound < maxSocketNums; ++i) {
+    if (batchStates[i] == NULL && streamStates[i] == NULL) continue;
+
+    ++numChecked;
+    if (isPending(i, timeNow)) socketNums[numFound++] = i;
+  }
+
+  return numFound;
+}
+
+unsigned RTSPClientBatchReader::usecsUntilNextDeadline() {
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+
+  unsigned result = ~0, numChecked = 0;
+  for (int i = 0; i < FD_SETSIZE && numChecked < numBatchedSockets; ++i) {
+    if (batchStates[i] == NULL && streamStates[i] == NULL) continue;
+
+    ++numChecked;
+    if (batchStates[i] != NULL && batchStates[i]->reorderRing != NULL) {
+      unsigned usecs = batchStates[i]->reorderRing->usecsUntilDeadline(timeNow);
+      if (usecs < result) result = usecs;
+    }
+  }
+
+  return result;
+}
+
+u_int64_t RTSPClientBatchReader::arrivalUsecs(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE) return 0;
+
+  if (batchStates[socketNum] != NULL) return batchStates[socketNum]->arrivalUsecs;
+  if (streamStates[socketNum] != NULL) return streamStates[socketNum]->arrivalUsecs;
+  return 0;
+}
+
+static int readNextPacket(UsageEnvironment& env, BatchState* state, int socket,
+                          unsigned char* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress) {
+  RTSPClientUring* uring = RTSPClientUring::current();
+  if (state->uringReceiving && uring != NULL && uring->isReceiving(socket)) {
+    // The kernel has already received the packets, into the io_uring's buffer pool:
+    int packetSize = uring->readPacket(socket, buffer, bufferSize, fromAddress);
+    if (packetSize == 0) fromAddress.sin_addr.s_addr = 0;
+    state->arrivalUsecs = uring->completionUsecs();
+    return packetSize;
+  }
+
+  if (state->nextPacket < state->numPackets) {
+    // Return the next cached packet:
+    unsigned i = state->nextPacket++;
+    unsigned packetSize = state->packetSizes[i];
+    if (packetSize > bufferSize) packetSize = bufferSize; // as "recvfrom()" would do
+    memcpy(buffer, state->slots[i], packetSize);
+    fromAddress = state->fromAddresses[i];
+    state->arrivalUsecs = state->batchArrivalUsecs;
+    return packetSize;
+  }
+
+  if (state->stopBatching) {
+    state->arrivalUsecs = RTSPClientLatencyHistogram::nowUsecs();
+    return (*liveReadSocket())(env, socket, buffer, bufferSize, fromAddress);
+  }
+
+  // Read a new batch.  The first packet goes directly into the caller's buffer; the rest into our cache:
+  struct mmsghdr msgs[RTSPCLIENT_BATCH_SIZE];
+  struct iovec iovs[RTSPCLIENT_BATCH_SIZE];
+  memset(msgs, 0, sizeof msgs);
+  for (unsigned i = 0; i < RTSPCLIENT_BATCH_SIZE; ++i) {
+    iovs[i].iov_base = i == 0 ? buffer : state->slots[i];
+    iovs[i].iov_len = i == 0 ? bufferSize : RTSPCLIENT_BATCH_SLOT_BYTES;
+    msgs[i].msg_hdr.msg_iov = &iovs[i];
+    msgs[i].msg_hdr.msg_iovlen = 1;
+    msgs[i].msg_hdr.msg_name = &state->fromAddresses[i];
+    msgs[i].msg_hdr.msg_namelen = sizeof state->fromAddresses[i];
+  }
+
+  state->numPackets = state->nextPacket = 0;
+  int numRead = recvmmsg(socket, msgs, RTSPCLIENT_BATCH_SIZE, MSG_DONTWAIT, NULL);
+  if (numRead < 0) {
+    // Treat these errors as 'no data', like live555's "readSocket()" does:
+    int err = env.getErrno();
+    if (err == ECONNREFUSED || err == EAGAIN || err == EWOULDBLOCK || err == EHOSTUNREACH || err == EINTR) {
+      fromAddress.sin_addr.s_addr = 0;
+      return 0;
+    }
+    env.setResultErrMsg("recvmmsg() error: ");
+    return -1;
+  }
+  if (numRead == 0) return 0;
+  state->arrivalUsecs = state->batchArrivalUsecs = RTSPClientLatencyHistogram::nowUsecs(); // (once per batch)
+
+  for (int i = 1; i < numRead; ++i) {
+    if (msgs[i].msg_hdr.msg_flags&MSG_TRUNC) {
+      // This datagram didn't fit in a cache slot (and has been lost).  Return the packets before it, then stop batching:
+      numRead = i;
+      state->stopBatching = True;
+      break;
+    }
+    state->packetSizes[i] = msgs[i].msg_len;
+  }
+  state->numPackets = numRead;
+  state->nextPacket = 1;
+
+  fromAddress = state->fromAddresses[0];
+  return msgs[0].msg_len;
+}
+
+static Boolean isRTPPacket(unsigned char const* packet, int packetSize) {
+  // A RTP (version 2) packet, and not a (multiplexed) RTCP packet (RFC 5761, section 4):
+  if (packetSize < 12 || (packet[0]&0xC0) != 0x80) return False;
+  unsigned char const payloadType = packet[1]&0x7F;
+  return payloadType < 64 || payloadType > 95;
+}
+
+static int batchedReadSocket(UsageEnvironment& env, BatchState* state, int socket,
+                             unsigned char* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress) {
+  RTSPClientReorderRing* ring = state->reorderRing;
+  if (ring == NULL) return readNextPacket(env, state, socket, buffer, bufferSize, fromAddress);
+
+  // Pass on packets in sequence number order.  Read packets (into the caller's buffer) until one can be passed on as is,
+  // or the ring has one to pass on, or there are no more:
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  while (1) {
+    if (ring->hasDeliverable(timeNow)) return ring->deliverNext(buffer, bufferSize, fromAddress, timeNow, &state->arrivalUsecs);
+
+    int packetSize = readNextPacket(env, state, socket, buffer, bufferSize, fromAddress);
+    if (packetSize <= 0 || !isRTPPacket(buffer, packetSize)) return packetSize;
+    if (ring->insert(buffer, packetSize, fromAddress, timeNow, state->arrivalUsecs) == RTSPClientReorderRing::DELIVER_NOW) {
+      return packetSize;
+    }
+  }
+}
+
+static int bufferedReadSocket(UsageEnvironment& env, StreamState* state, int socket,
+                              unsigned char* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress) {
+  if (state->nextByte == state->numBytes) {
+    // The buffer is empty; refill it (with live555's own "readSocket()", so that errors are handled as usual):
+    state->numBytes = state->nextByte = 0;
+    int bytesRead = (*liveReadSocket())(env, socket, state->buffer, sizeof state->buffer, state->fromAddress);
+    if (bytesRead < 0) {
+      // The connection has failed (or has been closed by the server), so live555 is about to close the socket:
+      RTSPClientBatchReader::disableStream(socket);
+    }
+    if (bytesRead <= 0) {
+      fromAddress.sin_addr.s_addr = 0;
+      return bytesRead;
+    }
+    state->numBytes = bytesRead;
+    state->arrivalUsecs = RTSPClientLatencyHistogram::nowUsecs();
+  }
+
+  unsigned numBytes = state->numBytes - state->nextByte;
+  if (numBytes > bufferSize) numBytes = bufferSize;
+  memcpy(buffer, &state->buffer[state->nextByte], numBytes);
+  state->nextByte += numBytes;
+  fromAddress = state->fromAddress;
+  return numBytes;
+}
+
+// Our replacement for live555's "readSocket()" (in "GroupsockHelper.cpp").  When "librtspclient" comes before
+// "libgroupsock" in the symbol lookup order, the calls to "readSocket()" from "libgroupsock" and "libliveMedia" come here:
+int readSocket(UsageEnvironment& env, int socket, unsigned char* buffer, unsigned bufferSize,
+               struct sockaddr_in& fromAddress) {
+  if (socket >= 0 && socket < FD_SETSIZE && batchStates[socket] != NULL) {
+    return batchedReadSocket(env, batchStates[socket], socket, buffer, bufferSize, fromAddress);
+  }
+  if (socket >= 0 && socket < FD_SETSIZE && streamStates[socket] != NULL) {
+    return bufferedReadSocket(env, streamStates[socket], socket, buffer, bufferSize, fromAddress);
+  }
+
+  ReadSocketFunc* func = liveReadSocket();
+  if (func == NULL) {
+    env.setResultMsg("Failed to find live555's readSocket()");
+    return -1;
+  }
+
+  return (*func)(env, socket, buffer, bufferSize, fromAddress);
+}
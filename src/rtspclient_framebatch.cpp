@@ -0,0 +1,133 @@
+#include <stdlib.h>
+#include <string.h>
+#include "rtspclient_framebatch.h"
+#include "rtspclient_latency.h"
+#include "rtspclient_scheduler.h"
+
+/*
+ * add 20261019
+ *
+ * Batched delivery of a session's frames (see "rtspclient_framebatch.h").
+ *
+*/
+
+RTSPClientFrameBatcher::RTSPClientFrameBatcher(UsageEnvironment& env, unsigned maxFrames, unsigned maxDelayUsecs,
+                                               RTSPClient_BatchCallBack* callBack, void* callBackData,
+                                               RTSPClientLatencyHistogram* latency, RTSPClientLoopUsage* loopUsage)
+  : fEnv(env), fMaxFrames(maxFrames > 0 ? maxFrames : 1), fMaxDelayUsecs(maxDelayUsecs),
+    fCallBack(callBack), fCallBackData(callBackData), fLatency(latency), fLoopUsage(loopUsage),
+    fNumFrames(0), fData(NULL), fDataSize(0), fDataCapacity(0), fDelayTask(NULL), fLastResult(RTSPC_CALLBACK_RET_OK),
+    fDeletedFlag(NULL) {
+  fFrames = new RTSPClientFrame[fMaxFrames];
+  fDataOffsets = new unsigned[fMaxFrames];
+  fArrivalUsecs = new u_int64_t[fMaxFrames];
+  fCompletionUsecs = new u_int64_t[fMaxFrames];
+}
+
+RTSPClientFrameBatcher::~RTSPClientFrameBatcher() {
+  if (fDeletedFlag != NULL) *fDeletedFlag = True;
+  fEnv.taskScheduler().unscheduleDelayedTask(fDelayTask);
+  delete[] fFrames;
+  delete[] fDataOffsets;
+  delete[] fArrivalUsecs;
+  delete[] fCompletionUsecs;
+  free(fData);
+}
+
+int RTSPClientFrameBatcher::add(RTSPClientAttr const& attr, int streamIndex, u_int8_t const* data, Boolean endsAccessUnit,
+                                u_int64_t arrivalUsecs, u_int64_t completionUsecs) {
+  // Report (once) what the callback returned if it was last called by the timer:
+  int result = fLastResult;
+  fLastResult = RTSPC_CALLBACK_RET_OK;
+
+  if (fDataSize + attr.m_uiDataLen > fDataCapacity) {
+    // Grow the buffer (at least doubling it, so that it soon fits a whole batch):
+    unsigned newCapacity = fDataCapacity*2;
+    if (newCapacity < fDataSize + attr.m_uiDataLen) newCapacity = fDataSize + attr.m_uiDataLen;
+    u_int8_t* newData = (u_int8_t*)realloc(fData, newCapacity);
+    if (newData == NULL) return result; // drop the frame
+    fData = newData;
+    fDataCapacity = newCapacity;
+  }
+
+  RTSPClientFrame& frame = fFrames[fNumFrames]; // alias
+  frame.m_stAttr = attr;
+  frame.m_iStream = streamIndex;
+  fDataOffsets[fNumFrames] = fDataSize;
+  fArrivalUsecs[fNumFrames] = arrivalUsecs;
+  fCompletionUsecs[fNumFrames] = completionUsecs;
+  memcpy(&fData[fDataSize], data, attr.m_uiDataLen);
+  fDataSize += attr.m_uiDataLen;
+
+  if (++fNumFrames == fMaxFrames || endsAccessUnit || fMaxDelayUsecs == 0) {
+    int flushResult = flush(); // (after which we may have been deleted)
+    if (flushResult != RTSPC_CALLBACK_RET_OK) result = flushResult;
+  } else if (fNumFrames == 1) {
+    gettimeofday(&fFirstFrameTime, NULL);
+    if (fDelayTask == NULL) fDelayTask = fEnv.taskScheduler().scheduleDelayedTask(fMaxDelayUsecs, delayExpired, this);
+  }
+  return result;
+}
+
+int RTSPClientFrameBatcher::flush() {
+  Boolean deleted;
+  return deliver(deleted);
+}
+
+int RTSPClientFrameBatcher::deliver(Boolean& deleted) {
+  // (We leave "fDelayTask" scheduled; see "delayExpired()".)
+  deleted = False;
+  if (fNumFrames == 0) return RTSPC_CALLBACK_RET_OK;
+
+  for (unsigned i = 0; i < fNumFrames; ++i) fFrames[i].m_pucData = &fData[fDataOffsets[i]];
+  unsigned numFrames = fNumFrames;
+  fNumFrames = fDataSize = 0; // before the call, in case it re-enters us
+  u_int64_t callUsecs = 0;
+  if (fLatency != NULL) {
+    callUsecs = RTSPClientLatencyHistogram::nowUsecs();
+    for (unsigned i = 0; i < numFrames; ++i) {
+      fLatency[RTSPC_LATENCY_FRAME_TO_CALLBACK].recordInterval(fCompletionUsecs[i], callUsecs);
+    }
+  }
+
+  // The callback may delete us (e.g., by stopping the session), so after it returns, we touch our members only if it didn't:
+  Boolean* outerDeletedFlag = fDeletedFlag;
+  fDeletedFlag = &deleted;
+  int result = (*fCallBack)(fFrames, (int)numFrames, fCallBackData);
+  if (deleted) {
+    if (outerDeletedFlag != NULL) *outerDeletedFlag = True;
+    return result;
+  }
+  fDeletedFlag = outerDeletedFlag;
+
+  if (fLatency != NULL) {
+    u_int64_t returnUsecs = RTSPClientLatencyHistogram::nowUsecs();
+    fLatency[RTSPC_LATENCY_CALLBACK].record(returnUsecs - callUsecs);
+    for (unsigned i = 0; i < numFrames; ++i) {
+      fLatency[RTSPC_LATENCY_ARRIVAL_TO_RETURN].recordInterval(fArrivalUsecs[i], returnUsecs);
+    }
+  }
+  return result;
+}
+
+void RTSPClientFrameBatcher::delayExpired(void* clientData) {
+  RTSPClientFrameBatcher* batcher = (RTSPClientFrameBatcher*)clientData;
+  batcher->fDelayTask = NULL;
+  if (batcher->fLoopUsage != NULL) ((RTSPClientTaskScheduler&)batcher->fEnv.taskScheduler()).setCurrentOwner(batcher->fLoopUsage);
+  if (batcher->fNumFrames == 0) return; // the batch was delivered early, and no frame has arrived since
+
+  // The batch may have started after we were scheduled; if so, wait until its first frame has waited for long enough:
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  long waitedUsecs = (timeNow.tv_sec - batcher->fFirstFrameTime.tv_sec)*1000000L
+    + (timeNow.tv_usec - batcher->fFirstFrameTime.tv_usec);
+  if (waitedUsecs >= 0 && waitedUsecs < (long)batcher->fMaxDelayUsecs) {
+    batcher->fDelayTask = batcher->fEnv.taskScheduler().scheduleDelayedTask(batcher->fMaxDelayUsecs - waitedUsecs,
+                                                                            delayExpired, batcher);
+    return;
+  }
+
+  Boolean deleted;
+  int result = batcher->deliver(deleted);
+  if (!deleted) batcher->fLastResult = result;
+}
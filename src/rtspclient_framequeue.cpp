@@ -0,0 +1,253 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "rtspclient_framequeue.h"
+#include "rtspclient_usdt.h"
+
+/*
+ * add 20261019
+ *
+ * A bounded queue of received frames, for pull-mode sessions (see "rtspclient_framequeue.h").
+ *
+*/
+
+#define FRAME_BUFFER_GRANULARITY 4096 // buffer sizes are rounded up to this, so that a buffer can be reused for most frames
+
+RTSPClientFrameQueue::RTSPClientFrameQueue(unsigned maxFrames, int overflowPolicy)
+  : fMaxFrames(maxFrames > 0 ? maxFrames : 1), fOverflowPolicy(overflowPolicy),
+    fHead(0), fNumFrames(0), fFreeBuffers(NULL), fIsOpen(False), fSessionId(0), fNumDropped(0), fEventFdIsReadable(False) {
+  pthread_mutex_init(&fMutex, NULL);
+
+  // Use the monotonic clock for timed waits, so that they aren't affected by changes to the time of day:
+  pthread_condattr_t condAttr;
+  pthread_condattr_init(&condAttr);
+  pthread_condattr_setclock(&condAttr, CLOCK_MONOTONIC);
+  pthread_cond_init(&fCond, &condAttr);
+  pthread_condattr_destroy(&condAttr);
+
+  fEntries = new Entry[fMaxFrames];
+  fEventFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+}
+
+RTSPClientFrameQueue::~RTSPClientFrameQueue() {
+  for (unsigned i = 0; i < fNumFrames; ++i) free(fEntries[(fHead + i)%fMaxFrames].buffer);
+  while (fFreeBuffers != NULL) {
+    Buffer* next = fFreeBuffers->next;
+    free(fFreeBuffers);
+    fFreeBuffers = next;
+  }
+  delete[] fEntries;
+  if (fEventFd >= 0) ::close(fEventFd);
+
+  pthread_cond_destroy(&fCond);
+  pthread_mutex_destroy(&fMutex);
+}
+
+void RTSPClientFrameQueue::open(unsigned sessionId) {
+  pthread_mutex_lock(&fMutex);
+  while (fNumFrames > 0) {
+    freeBuffer(fEntries[fHead].buffer);
+    fHead = (fHead + 1)%fMaxFrames;
+    --fNumFrames;
+  }
+  fIsOpen = True;
+  fSessionId = sessionId;
+  fNumDropped = 0;
+  updateEventFd();
+  pthread_mutex_unlock(&fMutex);
+}
+
+void RTSPClientFrameQueue::close() {
+  pthread_mutex_lock(&fMutex);
+  fIsOpen = False;
+  updateEventFd();
+  pthread_cond_broadcast(&fCond);
+  pthread_mutex_unlock(&fMutex);
+}
+
+RTSPClientFrameQueue::Buffer* RTSPClientFrameQueue::takeBuffer(unsigned size) {
+  Buffer* buffer = fFreeBuffers;
+  if (buffer != NULL) {
+    fFreeBuffers = buffer->next;
+    if (buffer->capacity >= size) return buffer;
+    free(buffer); // too small for this frame
+  }
+
+  unsigned capacity = (size + FRAME_BUFFER_GRANULARITY - 1)/FRAME_BUFFER_GRANULARITY*FRAME_BUFFER_GRANULARITY;
+  buffer = (Buffer*)malloc(sizeof (Buffer) + capacity);
+  if (buffer != NULL) buffer->capacity = capacity;
+  return buffer;
+}
+
+void RTSPClientFrameQueue::freeBuffer(Buffer* buffer) {
+  buffer->next = fFreeBuffers;
+  fFreeBuffers = buffer;
+}
+
+void RTSPClientFrameQueue::releaseLocked(RTSPClientFrame* frame) {
+  if (frame->m_pvBuffer == NULL) return;
+
+  freeBuffer((Buffer*)frame->m_pvBuffer);
+  frame->m_pvBuffer = NULL;
+  frame->m_pucData = NULL;
+}
+
+void RTSPClientFrameQueue::takeEntry(RTSPClientFrame* frame) {
+  Entry& entry = fEntries[fHead]; // alias
+  frame->m_stAttr = entry.attr;
+  frame->m_iStream = entry.streamIndex;
+  frame->m_pvBuffer = entry.buffer;
+  frame->m_pucData = (unsigned char*)(entry.buffer + 1);
+  fHead = (fHead + 1)%fMaxFrames;
+  --fNumFrames;
+}
+
+void RTSPClientFrameQueue::updateEventFd() {
+  if (fEventFd < 0) return;
+
+  Boolean shouldBeReadable = fNumFrames > 0 || !fIsOpen;
+  if (shouldBeReadable == fEventFdIsReadable) return;
+
+  u_int64_t counter = 1;
+  if (shouldBeReadable) {
+    if (write(fEventFd, &counter, sizeof counter) < 0) return;
+  } else {
+    if (read(fEventFd, &counter, sizeof counter) < 0) return;
+  }
+  fEventFdIsReadable = shouldBeReadable;
+}
+
+RTSPClientFrameQueue::PushResult RTSPClientFrameQueue::push(RTSPClientAttr const& attr, int streamIndex, u_int8_t const* data,
+                                                            unsigned maxAgeUsecs) {
+  u_int64_t nowUsecs = 0;
+  if (maxAgeUsecs > 0) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    nowUsecs = now.tv_sec*1000000ULL + now.tv_nsec/1000;
+  }
+
+  pthread_mutex_lock(&fMutex);
+  if (!fIsOpen) {
+    pthread_mutex_unlock(&fMutex);
+    return DROPPED;
+  }
+
+  if (maxAgeUsecs > 0 && fNumFrames > 0 && nowUsecs - fEntries[fHead].arrivalUsecs > maxAgeUsecs) {
+    // The consumer has fallen too far behind; the queued frames are stale:
+    fNumDropped += fNumFrames + 1;
+    RTSPCLIENT_PROBE4(queue_drop, fSessionId, streamIndex, fNumFrames + 1, 0/*behind*/);
+    while (fNumFrames > 0) {
+      freeBuffer(fEntries[fHead].buffer);
+      fHead = (fHead + 1)%fMaxFrames;
+      --fNumFrames;
+    }
+    updateEventFd();
+    pthread_mutex_unlock(&fMutex);
+    return BEHIND;
+  }
+
+  if (fNumFrames == fMaxFrames) {
+    ++fNumDropped;
+    RTSPCLIENT_PROBE4(queue_drop, fSessionId, streamIndex, 1, fOverflowPolicy == RTSPC_FRAMEQUEUE_DROP_NEWEST ? 1 : 2);
+    if (fOverflowPolicy == RTSPC_FRAMEQUEUE_DROP_NEWEST) {
+      pthread_mutex_unlock(&fMutex);
+      return DROPPED;
+    }
+
+    // RTSPC_FRAMEQUEUE_DROP_OLDEST: make room by dropping the oldest frame:
+    freeBuffer(fEntries[fHead].buffer);
+    fHead = (fHead + 1)%fMaxFrames;
+    --fNumFrames;
+  }
+
+  Buffer* buffer = takeBuffer(attr.m_uiDataLen);
+  if (buffer == NULL) {
+    ++fNumDropped;
+    RTSPCLIENT_PROBE4(queue_drop, fSessionId, streamIndex, 1, 3/*no memory*/);
+    pthread_mutex_unlock(&fMutex);
+    return DROPPED;
+  }
+  // (We copy the frame with the mutex locked; a consumer never holds it for long, so this doesn't make the event loop wait.)
+  memcpy((u_int8_t*)(buffer + 1), data, attr.m_uiDataLen);
+
+  Entry& entry = fEntries[(fHead + fNumFrames)%fMaxFrames]; // alias
+  entry.attr = attr;
+  entry.streamIndex = streamIndex;
+  entry.buffer = buffer;
+  entry.arrivalUsecs = nowUsecs;
+  ++fNumFrames;
+  updateEventFd();
+
+  pthread_cond_signal(&fCond);
+  pthread_mutex_unlock(&fMutex);
+  return QUEUED;
+}
+
+int RTSPClientFrameQueue::pop(RTSPClientFrame* frame, int timeoutMs) {
+  struct timespec deadline;
+  if (timeoutMs > 0) {
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeoutMs/1000;
+    deadline.tv_nsec += (timeoutMs%1000)*1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+      ++deadline.tv_sec;
+      deadline.tv_nsec -= 1000000000L;
+    }
+  }
+
+  pthread_mutex_lock(&fMutex);
+  releaseLocked(frame);
+
+  while (fNumFrames == 0) {
+    if (!fIsOpen) {
+      pthread_mutex_unlock(&fMutex);
+      return -1;
+    }
+    if (timeoutMs == 0) {
+      pthread_mutex_unlock(&fMutex);
+      return 1;
+    }
+
+    if (timeoutMs < 0) {
+      pthread_cond_wait(&fCond, &fMutex);
+    } else if (pthread_cond_timedwait(&fCond, &fMutex, &deadline) == ETIMEDOUT && fNumFrames == 0) {
+      pthread_mutex_unlock(&fMutex);
+      return fIsOpen ? 1 : -1;
+    }
+  }
+
+  takeEntry(frame);
+  updateEventFd();
+
+  pthread_mutex_unlock(&fMutex);
+  return 0;
+}
+
+int RTSPClientFrameQueue::popAvailable(RTSPClientFrame* frames, unsigned maxFrames) {
+  pthread_mutex_lock(&fMutex);
+  for (unsigned i = 0; i < maxFrames; ++i) releaseLocked(&frames[i]);
+
+  if (fNumFrames == 0 && !fIsOpen) {
+    pthread_mutex_unlock(&fMutex);
+    return -1;
+  }
+
+  unsigned numFrames = 0;
+  while (numFrames < maxFrames && fNumFrames > 0) takeEntry(&frames[numFrames++]);
+  updateEventFd();
+
+  pthread_mutex_unlock(&fMutex);
+  return (int)numFrames;
+}
+
+void RTSPClientFrameQueue::release(RTSPClientFrame* frame) {
+  if (frame->m_pvBuffer == NULL) return;
+
+  pthread_mutex_lock(&fMutex);
+  releaseLocked(frame);
+  pthread_mutex_unlock(&fMutex);
+}
+
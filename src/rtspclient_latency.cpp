@@ -0,0 +1,54 @@
+#include <string.h>
+#include "rtspclient_self.h"
+#include "rtspclient_latency.h"
+
+/*
+ * add 20261019
+ *
+ * Latency histograms of the frame path (see "rtspclient_latency.h").
+ *
+*/
+
+void RTSPClientLatencyHistogram::reset() {
+  for (unsigned i = 0; i < RTSPCLIENT_LATENCY_BUCKETS; ++i) __atomic_store_n(&fCounts[i], 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&fSumUsecs, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&fMaxUsecs, 0, __ATOMIC_RELAXED);
+}
+
+u_int64_t RTSPClientLatencyHistogram::highestValueIn(unsigned bucket) {
+  if (bucket < (1 << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS)) return bucket;
+
+  unsigned shift = (bucket >> RTSPCLIENT_LATENCY_SUB_BUCKET_BITS) - 1;
+  u_int64_t subBucket = bucket & ((1 << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS) - 1);
+  return ((((u_int64_t)1 << RTSPCLIENT_LATENCY_SUB_BUCKET_BITS) + subBucket + 1) << shift) - 1;
+}
+
+void RTSPClientLatencyHistogram::summarize(RTSPClientLatencyStats& stats) const {
+  memset(&stats, 0, sizeof stats);
+
+  // Take a copy of the counts (which the event loop may be adding to as we do this):
+  u_int32_t counts[RTSPCLIENT_LATENCY_BUCKETS];
+  u_int64_t numSamples = 0;
+  for (unsigned i = 0; i < RTSPCLIENT_LATENCY_BUCKETS; ++i) {
+    counts[i] = __atomic_load_n(&fCounts[i], __ATOMIC_RELAXED);
+    numSamples += counts[i];
+  }
+  if (numSamples == 0) return;
+  u_int64_t maxUsecs = __atomic_load_n(&fMaxUsecs, __ATOMIC_RELAXED);
+
+  stats.m_ullSamples = numSamples;
+  stats.m_uiMeanUs = (unsigned)(__atomic_load_n(&fSumUsecs, __ATOMIC_RELAXED)/numSamples);
+  stats.m_uiMaxUs = (unsigned)maxUsecs;
+
+  // Each percentile is the highest value of the bucket that holds it (but no more than the maximum):
+  static double const fractions[3] = { 0.5, 0.99, 0.999 };
+  unsigned* const results[3] = { &stats.m_uiP50Us, &stats.m_uiP99Us, &stats.m_uiP999Us };
+  u_int64_t numBelow = 0;
+  unsigned bucket = 0;
+  for (unsigned p = 0; p < 3; ++p) {
+    u_int64_t rank = (u_int64_t)(fractions[p]*numSamples + 0.999999); // i.e., rounded up, so at least 1
+    while (bucket < RTSPCLIENT_LATENCY_BUCKETS - 1 && numBelow + counts[bucket] < rank) numBelow += counts[bucket++];
+    u_int64_t value = highestValueIn(bucket);
+    *results[p] = (unsigned)(value < maxUsecs ? value : maxUsecs);
+  }
+}
@@ -0,0 +1,318 @@
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "rtspclient_log.h"
+
+/*
+ * add 20261019
+ *
+ * Leveled, asynchronous logging (see "rtspclient_log.h").
+ *
+*/
+
+// The ring is a bounded multi-producer queue (after D. Vyukov): a slot whose "sequence" equals the producer position may be
+// claimed (by advancing "s_tail" with a compare-and-swap); once filled in, its "sequence" becomes position+1, which is what
+// the (one) consumer - the writer thread - waits for; once written out, it becomes position+RTSPCLIENT_LOG_RING_LINES, i.e.,
+// free for the producer that's one lap ahead.
+struct LogSlot {
+  unsigned sequence;
+  int level;
+  struct timeval time;
+  char text[RTSPCLIENT_LOG_LINE_BYTES];
+};
+
+static LogSlot s_ring[RTSPCLIENT_LOG_RING_LINES];
+static unsigned s_tail = 0; // the next position to be claimed by a producer
+static unsigned s_head = 0; // the next position to be written out
+static unsigned s_numDropped = 0;
+static RTSPClient_LogCallBack* s_callBack = NULL;
+static void* s_callBackData = NULL;
+
+// The writer thread.  When it finds nothing to write, it sets "s_writerWaiting", looks once more, and then waits on "s_wakeUpFd";
+// a producer that then sees "s_writerWaiting" set (as it must, if the writer missed its line) wakes it.  So an idle writer costs
+// nothing, and producers make a system call only when it's idle:
+static pthread_mutex_t s_writerMutex = PTHREAD_MUTEX_INITIALIZER; // guards starting and stopping it
+static Boolean s_writerRunning = False;
+static Boolean s_writerStopping = False;
+static unsigned s_writerWaiting = 0;
+static int s_wakeUpFd = -1;
+static pthread_t s_writerThread;
+
+int RTSPClientLog::fLevel = RTSPC_LOG_LEVEL_INFO;
+
+void RTSPClientLog::setLevel(int level) {
+  __atomic_store_n(&fLevel, level, __ATOMIC_RELAXED);
+}
+
+void RTSPClientLog::setCallBack(RTSPClient_LogCallBack* callBack, void* callBackData) {
+  __atomic_store_n(&s_callBackData, callBackData, __ATOMIC_RELAXED);
+  __atomic_store_n(&s_callBack, callBack, __ATOMIC_RELEASE);
+}
+
+void RTSPClientLog::write(int level, RTSPClientLogLimiter* limiter, char const* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vwrite(level, limiter, format, args);
+  va_end(args);
+}
+
+void RTSPClientLog::vwrite(int level, RTSPClientLogLimiter* limiter, char const* format, va_list args) {
+  if (!__atomic_load_n(&s_writerRunning, __ATOMIC_ACQUIRE)) startWriter();
+
+  struct timeval timeNow;
+  gettimeofday(&timeNow, NULL);
+  unsigned numSuppressed = 0;
+  if (limiter != NULL) {
+    if (!limiter->allow(timeNow)) return;
+    numSuppressed = limiter->takeNumSuppressed();
+  }
+
+  // Claim a slot:
+  LogSlot* slot;
+  unsigned pos = __atomic_load_n(&s_tail, __ATOMIC_RELAXED);
+  for (;;) {
+    slot = &s_ring[pos&(RTSPCLIENT_LOG_RING_LINES-1)];
+    int diff = (int)(__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) - pos);
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&s_tail, &pos, pos+1, True, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+      // (else "pos" has been updated; try again)
+    } else if (diff < 0) {
+      __atomic_add_fetch(&s_numDropped, 1, __ATOMIC_RELAXED); // the ring is full
+      return;
+    } else {
+      pos = __atomic_load_n(&s_tail, __ATOMIC_RELAXED);
+    }
+  }
+
+  slot->level = level;
+  slot->time = timeNow;
+  int length = 0;
+  if (numSuppressed > 0) length = snprintf(slot->text, sizeof slot->text, "(%u lines suppressed) ", numSuppressed);
+  if (length < 0 || length >= (int)sizeof slot->text) length = 0;
+  vsnprintf(&slot->text[length], sizeof slot->text - length, format, args);
+
+  __atomic_store_n(&slot->sequence, pos+1, __ATOMIC_RELEASE);
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST); // (pairs with the writer's, between setting "s_writerWaiting" and looking again)
+  if (__atomic_load_n(&s_writerWaiting, __ATOMIC_RELAXED) && __atomic_exchange_n(&s_writerWaiting, 0, __ATOMIC_RELAXED)) {
+    wakeWriter();
+  }
+}
+
+void RTSPClientLog::flush() {
+  unsigned target = __atomic_load_n(&s_tail, __ATOMIC_ACQUIRE);
+  for (unsigned i = 0; i < 1000; ++i) {
+    if ((int)(__atomic_load_n(&s_head, __ATOMIC_ACQUIRE) - target) >= 0) return;
+    usleep(1000);
+  }
+}
+
+unsigned RTSPClientLog::numDropped() {
+  return __atomic_load_n(&s_numDropped, __ATOMIC_RELAXED);
+}
+
+void RTSPClientLog::startWriter() {
+  pthread_mutex_lock(&s_writerMutex);
+  if (!s_writerRunning) {
+    if (s_wakeUpFd < 0) { // the first time
+      for (unsigned i = 0; i < RTSPCLIENT_LOG_RING_LINES; ++i) s_ring[i].sequence = i;
+      s_wakeUpFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    }
+    s_writerStopping = False;
+    // (If the thread can't be created, lines are queued - and then dropped, once the ring is full - but never written:)
+    if (s_wakeUpFd >= 0 && pthread_create(&s_writerThread, NULL, writerThread, NULL) == 0) {
+      __atomic_store_n(&s_writerRunning, True, __ATOMIC_RELEASE);
+    }
+  }
+  pthread_mutex_unlock(&s_writerMutex);
+}
+
+void RTSPClientLog::stopWriter() {
+  pthread_mutex_lock(&s_writerMutex);
+  if (s_writerRunning) {
+    __atomic_store_n(&s_writerStopping, True, __ATOMIC_RELEASE);
+    wakeWriter();
+    pthread_join(s_writerThread, NULL);
+    __atomic_store_n(&s_writerRunning, False, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&s_writerMutex);
+}
+
+void RTSPClientLog::wakeWriter() {
+  if (eventfd_write(s_wakeUpFd, 1) < 0) {} // (the counter is saturated, so the writer will wake anyway)
+}
+
+void* RTSPClientLog::writerThread(void*) {
+  for (;;) {
+    if (writeQueued()) continue;
+    if (__atomic_load_n(&s_writerStopping, __ATOMIC_ACQUIRE)) break; // (having written everything logged so far)
+
+    __atomic_store_n(&s_writerWaiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    unsigned pos = s_head;
+    if (__atomic_load_n(&s_ring[pos&(RTSPCLIENT_LOG_RING_LINES-1)].sequence, __ATOMIC_ACQUIRE) != pos+1
+        && !__atomic_load_n(&s_writerStopping, __ATOMIC_ACQUIRE)) {
+      struct pollfd pfd = { s_wakeUpFd, POLLIN, 0 };
+      if (poll(&pfd, 1, -1) < 0) {} // (e.g., EINTR: just look again)
+    }
+    eventfd_t count;
+    if (eventfd_read(s_wakeUpFd, &count) < 0) {} // (EAGAIN: we didn't wait)
+    __atomic_store_n(&s_writerWaiting, 0, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+Boolean RTSPClientLog::writeQueued() {
+  static char const levelLetters[] = "-EWIDT";
+  char output[16384]; // lines for stderr, written with one "write()"
+  unsigned outputLength = 0;
+  unsigned pos = s_head;
+
+  for (;;) {
+    LogSlot& slot = s_ring[pos&(RTSPCLIENT_LOG_RING_LINES-1)]; // alias
+    Boolean haveLine = __atomic_load_n(&slot.sequence, __ATOMIC_ACQUIRE) == pos+1;
+    if (!haveLine || outputLength + 40 + RTSPCLIENT_LOG_LINE_BYTES > sizeof output) {
+      if (outputLength > 0 && ::write(STDERR_FILENO, output, outputLength) < 0) {} // nothing else we can do
+      outputLength = 0;
+      if (!haveLine) break;
+    }
+
+    char line[40 + RTSPCLIENT_LOG_LINE_BYTES];
+    struct tm timeFields;
+    time_t seconds = slot.time.tv_sec;
+    localtime_r(&seconds, &timeFields);
+    int length = snprintf(line, sizeof line, "%04d-%02d-%02d %02d:%02d:%02d.%06u %c %s",
+                          timeFields.tm_year + 1900, timeFields.tm_mon + 1, timeFields.tm_mday,
+                          timeFields.tm_hour, timeFields.tm_min, timeFields.tm_sec, (unsigned)slot.time.tv_usec,
+                          slot.level >= 1 && slot.level <= 5 ? levelLetters[slot.level] : '?', slot.text);
+    if (length >= (int)sizeof line) length = sizeof line - 1;
+    int level = slot.level;
+    __atomic_store_n(&slot.sequence, pos + RTSPCLIENT_LOG_RING_LINES, __ATOMIC_RELEASE); // the slot is free again
+    ++pos;
+
+    RTSPClient_LogCallBack* callBack = __atomic_load_n(&s_callBack, __ATOMIC_ACQUIRE);
+    if (callBack != NULL) {
+      (*callBack)(level, line, __atomic_load_n(&s_callBackData, __ATOMIC_RELAXED));
+    } else if (length > 0) {
+      memcpy(&output[outputLength], line, length);
+      outputLength += length;
+      output[outputLength++] = '\n';
+    }
+  }
+
+  Boolean wroteAny = pos != s_head;
+  __atomic_store_n(&s_head, pos, __ATOMIC_RELEASE);
+  return wroteAny;
+}
+
+
+////////// RTSPClientLogLimiter //////////
+
+RTSPClientLogLimiter::RTSPClientLogLimiter(unsigned linesPerSecond, unsigned burstLines)
+  : fLinesPerSecond(linesPerSecond), fBurstLines(burstLines), fTokens(burstLines), fNumSuppressed(0) {
+  fLastRefill.tv_sec = fLastRefill.tv_usec = 0;
+}
+
+Boolean RTSPClientLogLimiter::allow(struct timeval const& timeNow) {
+  if (fTokens < fBurstLines) {
+    // Add the tokens earned since the last refill (keeping the remainder for next time, by advancing "fLastRefill" only when
+    // a token is added):
+    long long elapsedUsecs = (timeNow.tv_sec - fLastRefill.tv_sec)*1000000LL + (timeNow.tv_usec - fLastRefill.tv_usec);
+    long long newTokens = elapsedUsecs*fLinesPerSecond/1000000;
+    if (newTokens > 0 || elapsedUsecs < 0) {
+      fTokens = newTokens >= (long long)(fBurstLines - fTokens) || elapsedUsecs < 0 ? fBurstLines : fTokens + (unsigned)newTokens;
+      fLastRefill = timeNow;
+    }
+  } else {
+    fLastRefill = timeNow;
+  }
+
+  if (fTokens == 0) {
+    ++fNumSuppressed;
+    return False;
+  }
+  --fTokens;
+  return True;
+}
+
+unsigned RTSPClientLogLimiter::takeNumSuppressed() {
+  unsigned numSuppressed = fNumSuppressed;
+  fNumSuppressed = 0;
+  return numSuppressed;
+}
+
+
+////////// RTSPClientUsageEnvironment //////////
+
+RTSPClientUsageEnvironment* RTSPClientUsageEnvironment::createNew(TaskScheduler& taskScheduler) {
+  return new RTSPClientUsageEnvironment(taskScheduler);
+}
+
+RTSPClientUsageEnvironment::RTSPClientUsageEnvironment(TaskScheduler& taskScheduler)
+  : BasicUsageEnvironment(taskScheduler), fLineLength(0),
+    fLimiter(RTSPCLIENT_LOG_ENV_LINES_PER_SECOND, 2*RTSPCLIENT_LOG_ENV_LINES_PER_SECOND) {
+}
+
+RTSPClientUsageEnvironment::~RTSPClientUsageEnvironment() {
+}
+
+void RTSPClientUsageEnvironment::append(char const* str) {
+  if (str == NULL) str = "(NULL)";
+
+  for (; *str != '\0'; ++str) {
+    if (*str == '\n' || fLineLength == sizeof fLine - 1) {
+      fLine[fLineLength] = '\0';
+      if (fLineLength > 0) RTSPC_LOG(RTSPC_LOG_LEVEL_INFO, &fLimiter, "%s", fLine);
+      fLineLength = 0;
+      if (*str == '\n') continue;
+    }
+    fLine[fLineLength++] = *str;
+  }
+}
+
+UsageEnvironment& RTSPClientUsageEnvironment::operator<<(char const* str) {
+  if (!isLogging()) return *this;
+
+  append(str);
+  return *this;
+}
+
+UsageEnvironment& RTSPClientUsageEnvironment::operator<<(int i) {
+  if (!isLogging()) return *this;
+
+  char buf[16];
+  snprintf(buf, sizeof buf, "%d", i);
+  append(buf);
+  return *this;
+}
+
+UsageEnvironment& RTSPClientUsageEnvironment::operator<<(unsigned u) {
+  if (!isLogging()) return *this;
+
+  char buf[16];
+  snprintf(buf, sizeof buf, "%u", u);
+  append(buf);
+  return *this;
+}
+
+UsageEnvironment& RTSPClientUsageEnvironment::operator<<(double d) {
+  if (!isLogging()) return *this;
+
+  char buf[32];
+  snprintf(buf, sizeof buf, "%f", d);
+  append(buf);
+  return *this;
+}
+
+UsageEnvironment& RTSPClientUsageEnvironment::operator<<(void* p) {
+  if (!isLogging()) return *this;
+
+  char buf[32];
+  snprintf(buf, sizeof buf, "%p", p);
+  append(buf);
+  return *this;
+}
@@ -0,0 +1,88 @@
+#include <pthread.h>
+#include "rtspclient_portpool.h"
+
+/*
+ * add 20260614
+ *
+ * Client RTP/RTCP port pairs (see "rtspclient_portpool.h").
+ *
+*/
+
+#define PORT_POOL_NO_PAIR (-1)
+
+static pthread_mutex_t portPoolMutex = PTHREAD_MUTEX_INITIALIZER;
+static portNumBits portPoolFirstPortNum = 0; // even
+static int portPoolNumPairs = 0;
+static int* portPoolNextFree = NULL; // per pair index: the next pair in the free list
+static Boolean* portPoolInUse = NULL;
+static int portPoolFreeHead = PORT_POOL_NO_PAIR, portPoolFreeTail = PORT_POOL_NO_PAIR;
+static int portPoolNumInUse = 0;
+
+Boolean RTSPClientPortPool::setRange(portNumBits firstPortNum, portNumBits lastPortNum) {
+  int numPairs = 0;
+  if (firstPortNum != 0) {
+    unsigned evenFirstPortNum = (firstPortNum + 1u)&~1u; // round up to even (65535 -> 65536, which isn't a port)
+    if (evenFirstPortNum > 65534 || lastPortNum <= evenFirstPortNum) return False;
+    firstPortNum = (portNumBits)evenFirstPortNum;
+    numPairs = (lastPortNum - firstPortNum + 1)/2;
+  }
+
+  pthread_mutex_lock(&portPoolMutex);
+  if (portPoolNumInUse > 0) {
+    pthread_mutex_unlock(&portPoolMutex);
+    return False;
+  }
+
+  delete[] portPoolNextFree; portPoolNextFree = NULL;
+  delete[] portPoolInUse; portPoolInUse = NULL;
+  portPoolFirstPortNum = firstPortNum;
+  portPoolNumPairs = numPairs;
+  portPoolFreeHead = portPoolFreeTail = PORT_POOL_NO_PAIR;
+  if (numPairs > 0) {
+    portPoolNextFree = new int[numPairs];
+    portPoolInUse = new Boolean[numPairs];
+    for (int i = 0; i < numPairs; ++i) {
+      portPoolNextFree[i] = i + 1 < numPairs ? i + 1 : PORT_POOL_NO_PAIR;
+      portPoolInUse[i] = False;
+    }
+    portPoolFreeHead = 0;
+    portPoolFreeTail = numPairs - 1;
+  }
+  pthread_mutex_unlock(&portPoolMutex);
+
+  return True;
+}
+
+portNumBits RTSPClientPortPool::allocate() {
+  portNumBits rtpPortNum = 0;
+
+  pthread_mutex_lock(&portPoolMutex);
+  int i = portPoolFreeHead;
+  if (i != PORT_POOL_NO_PAIR) {
+    portPoolFreeHead = portPoolNextFree[i];
+    if (portPoolFreeHead == PORT_POOL_NO_PAIR) portPoolFreeTail = PORT_POOL_NO_PAIR;
+    portPoolInUse[i] = True;
+    ++portPoolNumInUse;
+    rtpPortNum = portPoolFirstPortNum + 2*i;
+  }
+  pthread_mutex_unlock(&portPoolMutex);
+
+  return rtpPortNum;
+}
+
+void RTSPClientPortPool::release(portNumBits rtpPortNum) {
+  pthread_mutex_lock(&portPoolMutex);
+  int i = ((int)rtpPortNum - (int)portPoolFirstPortNum)/2;
+  if (rtpPortNum >= portPoolFirstPortNum && i < portPoolNumPairs && portPoolInUse[i]) {
+    portPoolInUse[i] = False;
+    --portPoolNumInUse;
+    portPoolNextFree[i] = PORT_POOL_NO_PAIR;
+    if (portPoolFreeTail == PORT_POOL_NO_PAIR) {
+      portPoolFreeHead = i;
+    } else {
+      portPoolNextFree[portPoolFreeTail] = i;
+    }
+    portPoolFreeTail = i;
+  }
+  pthread_mutex_unlock(&portPoolMutex);
+}
@@ -0,0 +1,161 @@
+#include <string.h>
+#include "rtspclient_reorder.h"
+#include "rtspclient_usdt.h"
+
+/*
+ * add 20260618
+ *
+ * Reordering of incoming RTP packets, in a ring indexed by sequence number (see "rtspclient_reorder.h").
+ *
+*/
+
+RTSPClientReorderRing::RTSPClientReorderRing(unsigned log2NumSlots, unsigned thresholdUsecs, unsigned sessionId, int streamIndex)
+  : fNumSlots(1<<log2NumSlots), fSlotMask((u_int16_t)(fNumSlots-1)), fThresholdUsecs(thresholdUsecs),
+    fSessionId(sessionId), fStreamIndex(streamIndex),
+    fHaveSeqNum(False), fNextSeqNum(0), fNumHeld(0), fFlushing(False),
+    fNumReordered(0), fNumSkipped(0), fNumDiscarded(0), fNumLate(0) {
+  fSlots = new Slot[fNumSlots];
+  memset(fSlots, 0, fNumSlots*sizeof (Slot));
+  memset(&fSpill, 0, sizeof fSpill);
+  fWaitStart.tv_sec = fWaitStart.tv_usec = 0;
+}
+
+RTSPClientReorderRing::~RTSPClientReorderRing() {
+  for (unsigned i = 0; i < fNumSlots; ++i) delete[] fSlots[i].data;
+  delete[] fSlots;
+  delete[] fSpill.data;
+}
+
+static void storePacket(u_int8_t*& data, u_int8_t const* packet, unsigned packetSize) {
+  if (data == NULL) data = new u_int8_t[RTSPCLIENT_REORDER_SLOT_BYTES];
+  memcpy(data, packet, packetSize);
+}
+
+RTSPClientReorderRing::InsertResult
+RTSPClientReorderRing::insert(u_int8_t const* packet, unsigned packetSize, struct sockaddr_in const& fromAddress,
+                              struct timeval const& timeNow, u_int64_t arrivalUsecs) {
+  u_int16_t const seqNum = (packet[2]<<8)|packet[3];
+  if (!fHaveSeqNum) {
+    fHaveSeqNum = True;
+    fNextSeqNum = seqNum + 1;
+    return DELIVER_NOW;
+  }
+  if (seqNum == fNextSeqNum && fNumHeld == 0) { // the usual case
+    ++fNextSeqNum;
+    return DELIVER_NOW;
+  }
+  if (packetSize > RTSPCLIENT_REORDER_SLOT_BYTES) return DELIVER_NOW; // we can't hold it
+
+  u_int16_t const ahead = seqNum - fNextSeqNum;
+  if (ahead >= 0x8000) {
+    // The packet comes before the next one that we expect:
+    if ((u_int16_t)(fNextSeqNum - seqNum) <= fNumSlots) {
+      ++fNumDiscarded; // we've already passed on (or given up on) this packet
+      Slot& slot = fSlots[seqNum&fSlotMask];
+      if (slot.skipped && slot.seqNum == seqNum) { // we gave up on it
+        ++fNumLate;
+        slot.skipped = False;
+      }
+      return DISCARDED;
+    }
+    // Otherwise, it's so far behind that the sender has probably restarted; resynchronize (below)
+  } else if (ahead < fNumSlots) {
+    // The packet fits in our window:
+    Slot& slot = fSlots[seqNum&fSlotMask];
+    if (slot.used) {
+      ++fNumDiscarded; // a duplicate
+      return DISCARDED;
+    }
+    storePacket(slot.data, packet, packetSize);
+    slot.used = True;
+    slot.skipped = False;
+    slot.seqNum = seqNum;
+    slot.size = packetSize;
+    slot.fromAddress = fromAddress;
+    slot.arrivalUsecs = arrivalUsecs;
+    if (fNumHeld++ == 0 && ahead > 0) startWaiting(timeNow); // we've just noticed a gap
+    return HELD;
+  }
+
+  // The packet is outside our window (or far behind it).  Resynchronize on it, once we've passed on the packets that we hold:
+  if (fNumHeld == 0) {
+    if (ahead < 0x8000) fNumSkipped += ahead;
+    fNextSeqNum = seqNum + 1;
+    return DELIVER_NOW;
+  }
+  if (fFlushing) { // we're already flushing (which shouldn't happen, because we're flushed before any more packets are read)
+    ++fNumDiscarded;
+    return DISCARDED;
+  }
+  storePacket(fSpill.data, packet, packetSize);
+  fSpill.used = True;
+  fSpill.seqNum = seqNum;
+  fSpill.size = packetSize;
+  fSpill.fromAddress = fromAddress;
+  fSpill.arrivalUsecs = arrivalUsecs;
+  fFlushing = True;
+  return HELD;
+}
+
+Boolean RTSPClientReorderRing::hasDeliverable(struct timeval const& timeNow) const {
+  if (fFlushing) return True;
+  if (fNumHeld == 0) return False;
+
+  return fSlots[fNextSeqNum&fSlotMask].used || usecsUntilDeadline(timeNow) == 0;
+}
+
+unsigned RTSPClientReorderRing::deliverNext(u_int8_t* buffer, unsigned bufferSize, struct sockaddr_in& fromAddress,
+                                            struct timeval const& timeNow, u_int64_t* arrivalUsecs) {
+  Slot* slot;
+  if (fNumHeld > 0) {
+    if (!fSlots[fNextSeqNum&fSlotMask].used) {
+      if (!fFlushing && usecsUntilDeadline(timeNow) > 0) return 0; // keep waiting for the missing packet
+      skipToNextHeld();
+    }
+    slot = &fSlots[fNextSeqNum&fSlotMask];
+    --fNumHeld;
+    ++fNextSeqNum;
+    ++fNumReordered;
+    if (fNumHeld > 0 && !fSlots[fNextSeqNum&fSlotMask].used) startWaiting(timeNow); // there's another gap
+  } else if (fFlushing) {
+    // We've passed on all of the held packets; now pass on the packet that we resynchronize on:
+    fFlushing = False;
+    if (!fSpill.used) return 0;
+    slot = &fSpill;
+    fNextSeqNum = fSpill.seqNum + 1;
+  } else {
+    return 0;
+  }
+
+  unsigned packetSize = slot->size;
+  if (packetSize > bufferSize) packetSize = bufferSize;
+  memcpy(buffer, slot->data, packetSize);
+  fromAddress = slot->fromAddress;
+  if (arrivalUsecs != NULL) *arrivalUsecs = slot->arrivalUsecs;
+  slot->used = False;
+  return packetSize;
+}
+
+unsigned RTSPClientReorderRing::usecsUntilDeadline(struct timeval const& timeNow) const {
+  if (fNumHeld == 0 || fSlots[fNextSeqNum&fSlotMask].used) return ~0;
+
+  long long elapsedUsecs = (timeNow.tv_sec - fWaitStart.tv_sec)*1000000LL + (timeNow.tv_usec - fWaitStart.tv_usec);
+  if (elapsedUsecs < 0) elapsedUsecs = 0; // the clock went backwards
+  return elapsedUsecs >= fThresholdUsecs ? 0 : (unsigned)(fThresholdUsecs - elapsedUsecs);
+}
+
+void RTSPClientReorderRing::startWaiting(struct timeval const& timeNow) {
+  fWaitStart = timeNow;
+}
+
+void RTSPClientReorderRing::skipToNextHeld() {
+  // Give up on the missing packets before the next one that we hold.  (There is one, within the window, because "fNumHeld" > 0.)
+  while (!fSlots[fNextSeqNum&fSlotMask].used) {
+    // Remember the missing packet's sequence number, so that we can tell if it arrives late:
+    fSlots[fNextSeqNum&fSlotMask].skipped = True;
+    fSlots[fNextSeqNum&fSlotMask].seqNum = fNextSeqNum;
+    RTSPCLIENT_PROBE4(packet_lost, fSessionId, fStreamIndex, fNextSeqNum, fThresholdUsecs);
+    ++fNextSeqNum;
+    ++fNumSkipped;
+  }
+}
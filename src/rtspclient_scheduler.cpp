@@ -0,0 +1,449 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "rtspclient_scheduler.h"
+#include "rtspclient_batch.h"
+
+/*
+ * add 20260617
+ *
+ * A "BasicTaskScheduler" that delivers the packets (and stream data) cached by "RTSPClientBatchReader" (see "rtspclient_scheduler.h").
+ *
+*/
+
+// The maximum number of times that we call each socket's handler for cached packets (or buffered stream data), before checking
+// the other sockets (and timers) again.  This is more than one batch of UDP packets, and enough for most interleaved frames in a
+// buffer of TCP data:
+#define MAX_PENDING_HANDLER_CALLS_PER_STEP 256
+
+// The longest that we wait on the io_uring in one step (so that the timeout, in microseconds, fits in a 32-bit "long"):
+#define MAX_URING_WAIT_SECONDS 1000
+
+// The longest that we wait in "select()" in one step (as "BasicTaskScheduler" does; very large timeouts make it fail):
+#define MAX_SELECT_WAIT_SECONDS 1000000
+
+RTSPClientTaskScheduler* RTSPClientTaskScheduler::createNew(unsigned maxSchedulerGranularity, Boolean wakeUpOnTrigger,
+                                                            Boolean useIOUring) {
+  RTSPClientUring* uring = useIOUring ? RTSPClientUring::createNew() : NULL;
+  if (uring != NULL) wakeUpOnTrigger = True; // we'll never use the 10 ms "select()" timeout to handle triggered events
+
+  int wakeUpFd = -1;
+  if (wakeUpOnTrigger) {
+    wakeUpFd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+    if (wakeUpFd >= 0 && wakeUpFd < (int)(FD_SETSIZE)) {
+      maxSchedulerGranularity = 0; // we no longer need to poll for triggered events
+    } else if (wakeUpFd >= 0) { // too large for "select()"
+      close(wakeUpFd);
+      wakeUpFd = -1;
+    }
+  }
+
+  if (uring != NULL && wakeUpFd < 0) { // without a wake-up fd, triggered events would wait for a socket or a timer
+    delete uring;
+    uring = NULL;
+  }
+
+  return new RTSPClientTaskScheduler(maxSchedulerGranularity, wakeUpFd, uring);
+}
+
+RTSPClientTaskScheduler::RTSPClientTaskScheduler(unsigned maxSchedulerGranularity, int wakeUpFd, RTSPClientUring* uring)
+  : BasicTaskScheduler(maxSchedulerGranularity), fNumHandledSockets(0), fWakeUpFd(wakeUpFd), fUring(uring),
+    fProfiling(False), fStallThresholdUsecs(0), fStallHandler(NULL), fStallHandlerClientData(NULL),
+    fTotalUsage(new RTSPClientLoopUsage), fCurrentOwner(NULL), fCurrentType(RTSP_HANDLER), fCallStartUsecs(0), fWaitUsecs(0),
+    fLagProbeDueUsecs(0) {
+  memset(fSocketHandlers, 0, sizeof fSocketHandlers);
+  for (unsigned i = 0; i < FD_SETSIZE; ++i) {
+    fSocketOwners[i].usage = NULL;
+    fSocketOwners[i].type = RTSP_HANDLER;
+  }
+  if (fWakeUpFd >= 0) {
+    setBackgroundHandling(fWakeUpFd, SOCKET_READABLE, wakeUpHandler, this);
+    fSocketOwners[fWakeUpFd].type = TRIGGER_HANDLER;
+  }
+}
+
+RTSPClientTaskScheduler::~RTSPClientTaskScheduler() {
+  if (fWakeUpFd >= 0) {
+    disableBackgroundHandling(fWakeUpFd);
+    close(fWakeUpFd);
+  }
+  delete fUring;
+  delete fTotalUsage;
+}
+
+void RTSPClientTaskScheduler::wakeUp() {
+  if (fWakeUpFd < 0) return;
+
+  eventfd_t one = 1;
+  if (write(fWakeUpFd, &one, sizeof one) < 0) {
+    // The counter is saturated (so the eventfd is readable anyway); ignore this
+  }
+}
+
+void RTSPClientTaskScheduler::triggerEvent(EventTriggerId eventTriggerId, void* clientData) {
+  BasicTaskScheduler::triggerEvent(eventTriggerId, clientData);
+  wakeUp(); // "BasicTaskScheduler" handles triggered events after "select()" returns, in the same step
+}
+
+void RTSPClientTaskScheduler::wakeUpHandler(void* clientData, int /*mask*/) {
+  RTSPClientTaskScheduler* scheduler = (RTSPClientTaskScheduler*)clientData;
+
+  eventfd_t count;
+  if (read(scheduler->fWakeUpFd, &count, sizeof count) < 0) {
+    // Nothing to read (another wake-up has already been read); ignore this
+  }
+}
+
+void RTSPClientTaskScheduler::enableProfiling(unsigned stallThresholdUsecs, StallHandlerProc* stallHandler,
+                                              void* stallHandlerClientData) {
+  fStallThresholdUsecs = stallThresholdUsecs;
+  fStallHandler = stallHandler;
+  fStallHandlerClientData = stallHandlerClientData;
+  if (fProfiling) return;
+
+  fProfiling = True;
+  fLagProbeDueUsecs = RTSPClientLatencyHistogram::nowUsecs() + RTSPCLIENT_LOOP_LAG_PROBE_USECS;
+  scheduleDelayedTask(RTSPCLIENT_LOOP_LAG_PROBE_USECS, lagProbeHandler, this);
+}
+
+void RTSPClientTaskScheduler::lagProbeHandler(void* clientData) {
+  RTSPClientTaskScheduler* scheduler = (RTSPClientTaskScheduler*)clientData;
+
+  u_int64_t nowUsecs = RTSPClientLatencyHistogram::nowUsecs();
+  scheduler->fLag.recordInterval(scheduler->fLagProbeDueUsecs, nowUsecs);
+  scheduler->fLagProbeDueUsecs = nowUsecs + RTSPCLIENT_LOOP_LAG_PROBE_USECS;
+  scheduler->scheduleDelayedTask(RTSPCLIENT_LOOP_LAG_PROBE_USECS, lagProbeHandler, scheduler);
+}
+
+void RTSPClientTaskScheduler::setSocketOwner(int socketNum, RTSPClientLoopUsage* owner, HandlerType type) {
+  if (socketNum < 0 || socketNum >= (int)(FD_SETSIZE)) return;
+
+  fSocketOwners[socketNum].usage = owner;
+  fSocketOwners[socketNum].type = type;
+}
+
+void RTSPClientTaskScheduler::forgetOwner(RTSPClientLoopUsage* owner) {
+  for (unsigned i = 0; i < FD_SETSIZE; ++i) {
+    if (fSocketOwners[i].usage == owner) {
+      fSocketOwners[i].usage = NULL;
+      fSocketOwners[i].type = RTSP_HANDLER;
+    }
+  }
+  if (fCurrentOwner == owner) fCurrentOwner = NULL; // (it may be deleted by the handler call that's in progress)
+}
+
+void RTSPClientTaskScheduler::callSocketHandler(int socketNum, int resultConditionSet) {
+  // Note: copy the handler, in case the call changes it:
+  BackgroundHandlerProc* proc = fSocketHandlers[socketNum].proc;
+  void* clientData = fSocketHandlers[socketNum].clientData;
+  if (!fProfiling) {
+    (*proc)(clientData, resultConditionSet);
+    return;
+  }
+
+  startCall(fSocketOwners[socketNum].type, fSocketOwners[socketNum].usage);
+  (*proc)(clientData, resultConditionSet);
+  endCall(socketNum);
+}
+
+void RTSPClientTaskScheduler::startCall(HandlerType type, RTSPClientLoopUsage* owner) {
+  fCurrentType = type;
+  fCurrentOwner = owner;
+  fCallStartUsecs = RTSPClientLatencyHistogram::nowUsecs();
+}
+
+void RTSPClientTaskScheduler::endCall(int socketNum) {
+  u_int64_t usecs = RTSPClientLatencyHistogram::nowUsecs() - fCallStartUsecs;
+  RTSPClientLoopUsage* owner = fCurrentOwner;
+  fCurrentOwner = NULL;
+
+  fTotalUsage->add(fCurrentType, usecs);
+  if (owner != NULL) owner->add(fCurrentType, usecs);
+  if (fStallThresholdUsecs > 0 && usecs >= fStallThresholdUsecs) {
+    fTotalUsage->addStall();
+    if (owner != NULL) owner->addStall();
+    if (fStallHandler != NULL) (*fStallHandler)(fStallHandlerClientData, owner, fCurrentType, socketNum, usecs);
+  }
+}
+
+void RTSPClientTaskScheduler::addWait(u_int64_t startUsecs) {
+  __atomic_store_n(&fWaitUsecs, fWaitUsecs + (RTSPClientLatencyHistogram::nowUsecs() - startUsecs), __ATOMIC_RELAXED);
+}
+
+void RTSPClientTaskScheduler::SingleStep(unsigned maxDelayTime) {
+  // If we've just delivered cached packets (or buffered stream data), then don't let "select()" block in this step (just as
+  // "BasicTaskScheduler" would come straight back to "select()" after handling a socket).  This also lets us come back promptly
+  // to any packets that remain cached after we've delivered our quota.  ("BasicTaskScheduler" treats a "maxDelayTime" of 0 as
+  // 'no limit', so use the smallest non-zero value.)
+  if (handlePendingPackets() > 0) maxDelayTime = 1;
+
+  // Also don't block past the time when a reordering socket should give up waiting for a missing packet:
+  unsigned usecsUntilDeadline = RTSPClientBatchReader::usecsUntilNextDeadline();
+  if (usecsUntilDeadline != ~0U) {
+    if (usecsUntilDeadline == 0) usecsUntilDeadline = 1;
+    if (maxDelayTime == 0 || usecsUntilDeadline < maxDelayTime) maxDelayTime = usecsUntilDeadline;
+  }
+
+  if (fUring != NULL) {
+    uringSingleStep(maxDelayTime);
+  } else if (fProfiling) {
+    selectSingleStep(maxDelayTime);
+  } else {
+    BasicTaskScheduler::SingleStep(maxDelayTime);
+  }
+}
+
+void RTSPClientTaskScheduler::selectSingleStep(unsigned maxDelayTime) {
+  // As "BasicTaskScheduler::SingleStep()" does, but timing the "select()" and each handler call:
+  fd_set readSet = fReadSet; // make a copy for this select() call
+  fd_set writeSet = fWriteSet; // ditto
+  fd_set exceptionSet = fExceptionSet; // ditto
+
+  DelayInterval const& timeToDelay = fDelayQueue.timeToNextAlarm();
+  struct timeval tv_timeToDelay;
+  tv_timeToDelay.tv_sec = timeToDelay.seconds();
+  tv_timeToDelay.tv_usec = timeToDelay.useconds();
+  if (tv_timeToDelay.tv_sec > MAX_SELECT_WAIT_SECONDS) {
+    tv_timeToDelay.tv_sec = MAX_SELECT_WAIT_SECONDS;
+    tv_timeToDelay.tv_usec = 0;
+  }
+  if (maxDelayTime > 0 && (u_int64_t)tv_timeToDelay.tv_sec*1000000 + tv_timeToDelay.tv_usec > maxDelayTime) {
+    tv_timeToDelay.tv_sec = maxDelayTime/1000000;
+    tv_timeToDelay.tv_usec = maxDelayTime%1000000;
+  }
+
+  u_int64_t waitStartUsecs = RTSPClientLatencyHistogram::nowUsecs();
+  int selectResult = select(fMaxNumSockets, &readSet, &writeSet, &exceptionSet, &tv_timeToDelay);
+  addWait(waitStartUsecs);
+  if (selectResult < 0) {
+    if (errno != EINTR && errno != EAGAIN) {
+      // Unexpected error - treat this as fatal:
+      perror("RTSPClientTaskScheduler::SingleStep(): select() fails");
+      internalError();
+    }
+    selectResult = 0; // (the sets are undefined)
+  }
+
+  // Call the handler of one ready socket.  To ensure forward progress through the sockets, begin past the last one that we handled:
+  for (int i = 0; selectResult > 0 && i < fMaxNumSockets && i < (int)(FD_SETSIZE); ++i) {
+    int sock = (fLastHandledSocketNum + 1 + i)%fMaxNumSockets;
+    if (sock < 0 || sock >= (int)(FD_SETSIZE)) continue;
+
+    SocketHandler const& handler = fSocketHandlers[sock];
+    if (handler.proc == NULL) continue;
+    int resultConditionSet = 0;
+    if (FD_ISSET(sock, &readSet) && FD_ISSET(sock, &fReadSet)/*sanity check*/) resultConditionSet |= SOCKET_READABLE;
+    if (FD_ISSET(sock, &writeSet) && FD_ISSET(sock, &fWriteSet)/*sanity check*/) resultConditionSet |= SOCKET_WRITABLE;
+    if (FD_ISSET(sock, &exceptionSet) && FD_ISSET(sock, &fExceptionSet)/*sanity check*/) resultConditionSet |= SOCKET_EXCEPTION;
+    resultConditionSet &= handler.conditionSet;
+    if (resultConditionSet == 0) continue;
+
+    fLastHandledSocketNum = sock;
+    callSocketHandler(sock, resultConditionSet);
+    break;
+  }
+
+  handleTriggeredEvents();
+
+  // Also handle any delayed event that may have come due:
+  handleAlarm();
+}
+
+void RTSPClientTaskScheduler::uringSingleStep(unsigned maxDelayTime) {
+  // Arm a poll on each socket that needs one (i.e., one that has a handler, and whose packets don't come to the io_uring):
+  for (unsigned i = 0; i < fNumHandledSockets; ++i) {
+    int sock = fHandledSockets[i];
+    if (!fUring->isPollArmed(sock) && !fUring->isReceiving(sock)) {
+      fUring->armPoll(sock, fSocketHandlers[sock].conditionSet);
+    }
+  }
+
+  // Wait until a socket is ready (or a packet has been received), or until the next timer is due:
+  DelayInterval const& timeToDelay = fDelayQueue.timeToNextAlarm();
+  long timeoutUsecs = timeToDelay.seconds() >= MAX_URING_WAIT_SECONDS
+    ? MAX_URING_WAIT_SECONDS*1000000L : timeToDelay.seconds()*1000000L + timeToDelay.useconds();
+  if (maxDelayTime > 0 && timeoutUsecs > (long)maxDelayTime) timeoutUsecs = maxDelayTime;
+  u_int64_t waitStartUsecs = fProfiling ? RTSPClientLatencyHistogram::nowUsecs() : 0;
+  unsigned numReady = fUring->wait(timeoutUsecs, fReadiness, FD_SETSIZE);
+  if (fProfiling) addWait(waitStartUsecs);
+
+  // Call the handler of every socket that's ready.  (A handler may close - or change the handling of - other sockets, so
+  // check that each one is still being polled for the same handler first.)
+  for (unsigned i = 0; i < numReady; ++i) {
+    RTSPClientUring::Readiness const& ready = fReadiness[i];
+    if (fUring->pollGeneration(ready.socketNum) != ready.generation) continue;
+
+    SocketHandler const& handler = fSocketHandlers[ready.socketNum];
+    int resultConditionSet = ready.conditionSet&handler.conditionSet;
+    if (handler.proc == NULL || resultConditionSet == 0) continue;
+
+    fLastHandledSocketNum = ready.socketNum;
+    callSocketHandler(ready.socketNum, resultConditionSet);
+  }
+
+  // (Received packets are delivered by "handlePendingPackets()", at the start of the next step.)
+
+  handleTriggeredEvents();
+
+  // Also handle any delayed event that may have come due:
+  handleAlarm();
+}
+
+void RTSPClientTaskScheduler::handleAlarm() {
+  if (!fProfiling) {
+    fDelayQueue.handleAlarm();
+    return;
+  }
+
+  // Time the call only if an alarm is due (so that it calls a handler):
+  DelayInterval const& timeToDelay = fDelayQueue.timeToNextAlarm();
+  if (timeToDelay.seconds() != 0 || timeToDelay.useconds() != 0) return;
+
+  startCall(TIMER_HANDLER, NULL);
+  fDelayQueue.handleAlarm();
+  endCall(-1);
+}
+
+void RTSPClientTaskScheduler::callTriggeredEventHandler(unsigned triggerNum) {
+  if (fTriggeredEventHandlers[triggerNum] == NULL) return;
+  if (!fProfiling) {
+    (*fTriggeredEventHandlers[triggerNum])(fTriggeredEventClientDatas[triggerNum]);
+    return;
+  }
+
+  startCall(TRIGGER_HANDLER, NULL);
+  (*fTriggeredEventHandlers[triggerNum])(fTriggeredEventClientDatas[triggerNum]);
+  endCall(-1);
+}
+
+void RTSPClientTaskScheduler::handleTriggeredEvents() {
+  // As "BasicTaskScheduler::SingleStep()" does:
+  if (fTriggersAwaitingHandling == 0) return;
+
+  if (fTriggersAwaitingHandling == fLastUsedTriggerMask) {
+    // Common-case optimization for a single event trigger:
+    fTriggersAwaitingHandling &=~ fLastUsedTriggerMask;
+    callTriggeredEventHandler(fLastUsedTriggerNum);
+  } else {
+    // Look for an event trigger that needs handling (making sure that we make forward progress through all possible triggers):
+    unsigned i = fLastUsedTriggerNum;
+    EventTriggerId mask = fLastUsedTriggerMask;
+
+    do {
+      i = (i+1)%MAX_NUM_EVENT_TRIGGERS;
+      mask >>= 1;
+      if (mask == 0) mask = 0x80000000;
+
+      if ((fTriggersAwaitingHandling&mask) != 0) {
+        fTriggersAwaitingHandling &=~ mask;
+        callTriggeredEventHandler(i);
+
+        fLastUsedTriggerMask = mask;
+        fLastUsedTriggerNum = i;
+        break;
+      }
+    } while (i != fLastUsedTriggerNum);
+  }
+}
+
+unsigned RTSPClientTaskScheduler::handlePendingPackets() {
+  int socketNums[FD_SETSIZE];
+  unsigned numSockets = RTSPClientBatchReader::pendingSockets(socketNums, FD_SETSIZE);
+  unsigned numHandlerCalls = 0;
+
+  for (unsigned i = 0; i < numSockets; ++i) {
+    int sock = socketNums[i];
+    for (unsigned j = 0; j < MAX_PENDING_HANDLER_CALLS_PER_STEP; ++j) {
+      // Note that the handler may close (or change the handling of) the socket, so check this each time:
+      SocketHandler const& handler = fSocketHandlers[sock];
+      if (handler.proc == NULL || (handler.conditionSet&SOCKET_READABLE) == 0
+          || !RTSPClientBatchReader::hasPendingPackets(sock)) break;
+
+      callSocketHandler(sock, SOCKET_READABLE);
+      ++numHandlerCalls;
+    }
+  }
+
+  return numHandlerCalls;
+}
+
+void RTSPClientTaskScheduler::setBackgroundHandling(int socketNum, int conditionSet,
+                                                    BackgroundHandlerProc* handlerProc, void* clientData) {
+  BasicTaskScheduler::setBackgroundHandling(socketNum, conditionSet, handlerProc, clientData);
+  if (socketNum < 0 || socketNum >= (int)(FD_SETSIZE)) return;
+
+  SocketHandler& handler = fSocketHandlers[socketNum]; // alias
+  if (handlerProc == NULL || conditionSet == 0) {
+    handlerProc = NULL;
+    conditionSet = 0;
+    clientData = NULL;
+  }
+  if (fUring != NULL && (handlerProc == NULL || conditionSet != handler.conditionSet)) {
+    fUring->cancelPoll(socketNum); // it's re-armed (if necessary) in the next step
+  }
+  if (handler.proc == NULL && handlerProc != NULL) {
+    addHandledSocket(socketNum);
+  } else if (handler.proc != NULL && handlerProc == NULL) {
+    removeHandledSocket(socketNum);
+  }
+  if (handlerProc == NULL) {
+    // live555 may be about to close the socket without telling us (e.g., "RTSPClient::resetTCPSockets()"), and its number be
+    // reused; so forget any of its stream data that we've buffered (see "rtspclient_batch.h"):
+    RTSPClientBatchReader::disableStream(socketNum);
+  }
+  handler.conditionSet = conditionSet;
+  handler.proc = handlerProc;
+  handler.clientData = clientData;
+}
+
+void RTSPClientTaskScheduler::moveSocketHandling(int oldSocketNum, int newSocketNum) {
+  BasicTaskScheduler::moveSocketHandling(oldSocketNum, newSocketNum);
+  if (oldSocketNum < 0 || oldSocketNum >= (int)(FD_SETSIZE) || newSocketNum < 0 || newSocketNum >= (int)(FD_SETSIZE)) return;
+  if (oldSocketNum == newSocketNum) return;
+
+  RTSPClientBatchReader::disableStream(oldSocketNum); // (as in "setBackgroundHandling()")
+  if (fUring != NULL) {
+    fUring->cancelPoll(oldSocketNum);
+    fUring->cancelPoll(newSocketNum);
+  }
+  if (fSocketHandlers[newSocketNum].proc != NULL) removeHandledSocket(newSocketNum);
+  if (fSocketHandlers[oldSocketNum].proc != NULL) fHandledSockets[fSocketHandlers[oldSocketNum].index] = newSocketNum;
+  fSocketHandlers[newSocketNum] = fSocketHandlers[oldSocketNum];
+  memset(&fSocketHandlers[oldSocketNum], 0, sizeof fSocketHandlers[oldSocketNum]);
+  fSocketOwners[newSocketNum] = fSocketOwners[oldSocketNum];
+  fSocketOwners[oldSocketNum].usage = NULL;
+  fSocketOwners[oldSocketNum].type = RTSP_HANDLER;
+}
+
+void RTSPClientTaskScheduler::addHandledSocket(int socketNum) {
+  fSocketHandlers[socketNum].index = fNumHandledSockets;
+  fHandledSockets[fNumHandledSockets++] = socketNum;
+}
+
+void RTSPClientTaskScheduler::removeHandledSocket(int socketNum) {
+  // Move the last socket into its place:
+  unsigned index = fSocketHandlers[socketNum].index;
+  int lastSocketNum = fHandledSockets[--fNumHandledSockets];
+  fHandledSockets[index] = lastSocketNum;
+  fSocketHandlers[lastSocketNum].index = index;
+}
+
+
+// Implementation of "RTSPClientLoopUsage":
+
+RTSPClientLoopUsage::RTSPClientLoopUsage(void* owner)
+  : fOwner(owner), fStalls(0) {
+  for (unsigned i = 0; i < RTSPClientTaskScheduler::NUM_HANDLER_TYPES; ++i) fUsecs[i] = fCalls[i] = fMaxUsecs[i] = 0;
+}
+
+void RTSPClientLoopUsage::reset(void* owner) {
+  fOwner = owner;
+  for (unsigned i = 0; i < RTSPClientTaskScheduler::NUM_HANDLER_TYPES; ++i) {
+    __atomic_store_n(&fUsecs[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&fCalls[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&fMaxUsecs[i], 0, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&fStalls, 0, __ATOMIC_RELAXED);
+}
@@ -1,6 +1,21 @@
 
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
 #include "rtspclient_self.h"
+#include "rtspclient_tls.h"
+#include "rtspclient_srtp.h"
+#include "rtspclient_portpool.h"
+#include "rtspclient_batch.h"
+#include "rtspclient_reorder.h"
+#include "rtspclient_scheduler.h"
+#include "rtspclient_affinity.h"
+#include "rtspclient_framequeue.h"
+#include "rtspclient_framebatch.h"
+#include "rtspclient_log.h"
+#include "rtspclient_latency.h"
+#include "rtspclient_timeline.h"
+#include "rtspclient_usdt.h"
 
 /**********
 This library is free software; you can redistribute it and/or modify it under
@@ -25,6 +40,7 @@ along with this library; if not, write to the Free Software Foundation, Inc.,
 // "openRTSP": http://www.live555.com/openRTSP/
 
 #include "liveMedia.hh"
+#include "GroupsockHelper.hh"
 #include "BasicUsageEnvironment.hh"
 
 // Forward function definitions:
@@ -40,9 +56,20 @@ void subsessionByeHandler(void* clientData, char const* reason);
   // called when a RTCP "BYE" is received for a subsession
 void streamTimerHandler(void* clientData);
   // called at the end of a stream's expected duration (if the stream has not already signaled its end using a RTCP "BYE")
+void transportCheckHandler(void* clientData);
+  // called periodically for RTSPC_TRANSPORT_AUTO streams that are still using UDP
+void streamStatsHandler(void* clientData);
+  // called periodically, to update each stream's "RTSPClientStreamStats"
+void jitterBufferHandler(void* clientData);
+  // called periodically, to resize each subsession's wait for missing packets (see "m_uiJitterBufferMinMs")
 
 // The main streaming routine (for each "rtsp://" URL):
-RTSPClient* openURL(UsageEnvironment& env, char const* progName, char const* rtspURL);
+RTSPClient* openURL(UsageEnvironment& env, char const* progName, char const* rtspURL,
+                    RTSPClientInfo const* rtspClientInfo = NULL, int verbosityLevel = 1,
+                    RTSPClientSessionData* sessionData = NULL);
+
+// Used to restart a RTSPC_TRANSPORT_AUTO stream using RTP-over-TCP:
+void restartStreamOverTCP(RTSPClient* rtspClient);
 
 // Used to iterate through each stream's 'subsessions', setting up each one:
 void setupNextSubsession(RTSPClient* rtspClient);
@@ -60,6 +87,10 @@ UsageEnvironment& operator<<(UsageEnvironment& env, const MediaSubsession& subse
   return env << subsession.mediumName() << "/" << subsession.codecName();
 }
 
+// Logs a line about a stream - identified as above - subject to the stream's own rate limit (see "rtspclient_log.h"):
+#define STREAM_LOG(level, rtspClient, format, ...) \
+  RTSPC_LOG(level, &((ourRTSPClient*)(rtspClient))->m_logLimiter, "[URL:\"%s\"]: " format, (rtspClient)->url(), ##__VA_ARGS__)
+
 void usage(UsageEnvironment& env, char const* progName) {
   env << "Usage: " << progName << " <rtsp-url-1> ... <rtsp-url-N>\n";
   env << "\t(where each <rtsp-url-i> is a \"rtsp://\" URL)\n";
@@ -80,16 +111,11 @@ int main_rtspclient(int argc, char** argv) {
 
   // There are argc-1 URLs: argv[1] through argv[argc-1].  Open and start streaming each one:
   for (int i = 1; i <= argc-1; ++i) {
-#include <asm-generic/unistd.h>
-      //__NR_gettid = 186
-    *env << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << " " << argv[i]  << "\n";
     openURL(*env, argv[0], argv[i]);
   }
 
   // All subsequent activity takes place within the event loop:
-  *env << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
   env->taskScheduler().doEventLoop(&eventLoopWatchVariable);
-  *env << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
     // This function call does not return, unless, at some point in time, "eventLoopWatchVariable" gets set to something non-zero.
 
   return 0;
@@ -103,6 +129,66 @@ int main_rtspclient(int argc, char** argv) {
   */
 }
 
+// Define a class to hold what a "RTSPClientSession" shares with the event loop.  It's owned by the session - so it outlives each
+// "RTSPClient" that the session starts - but only the event loop changes it:
+
+class RTSPClientSessionData {
+public:
+  RTSPClientSessionData() : fRTSPClient(NULL), fStatsSequence(0), fNumStreamStats(0), fSessionId(0) {}
+
+  RTSPClient* rtspClient() const { return __atomic_load_n(&fRTSPClient, __ATOMIC_ACQUIRE); } // any thread
+      // The session's running client: set when it's created, and cleared (before it's closed) once it begins to shut down
+  void setRTSPClient(RTSPClient* rtspClient) { __atomic_store_n(&fRTSPClient, rtspClient, __ATOMIC_RELEASE); }
+
+  void publishStreamStats(RTSPClientStreamStats const* streamStats, int numStreams);
+  int getStreamStats(RTSPClientStreamStats* streamStats, int maxStreams) const; // any thread; returns the number of streams
+
+  RTSPClientLatencyHistogram* latency() { return fLatency; } // RTSPC_LATENCY_STAGES of them (see "rtspclient_latency.h")
+  void resetLatency() { for (unsigned i = 0; i < RTSPC_LATENCY_STAGES; ++i) fLatency[i].reset(); }
+
+  RTSPClientLoopUsage& loopUsage() { return fLoopUsage; } // its owner is the running client (see "rtspclient_scheduler.h")
+
+  // The startup timeline of the session's latest client (kept after it has gone, e.g., because the startup failed):
+  RTSPClientTimeline& timeline() { return fTimeline; }
+  unsigned sessionId() const { return __atomic_load_n(&fSessionId, __ATOMIC_ACQUIRE); } // 0: never started
+  void setSessionId(unsigned sessionId) { __atomic_store_n(&fSessionId, sessionId, __ATOMIC_RELEASE); }
+
+private:
+  RTSPClient* fRTSPClient;
+
+  // The latest "RTSPClientStreamStats".  They're guarded by a sequence number (a 'seqlock'): it's odd while they're being
+  // written, so a reader that sees it odd - or changed, once it has copied them - copies them again.  So the event loop never
+  // waits for a reader:
+  unsigned fStatsSequence;
+  RTSPClientStreamStats fStreamStats[RTSPCLIENT_MAX_STREAMS];
+  int fNumStreamStats;
+
+  RTSPClientLatencyHistogram fLatency[RTSPC_LATENCY_STAGES];
+  RTSPClientLoopUsage fLoopUsage;
+  RTSPClientTimeline fTimeline;
+  unsigned fSessionId;
+};
+
+void RTSPClientSessionData::publishStreamStats(RTSPClientStreamStats const* streamStats, int numStreams) {
+  __atomic_store_n(&fStatsSequence, fStatsSequence + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  if (numStreams > 0) memcpy(fStreamStats, streamStats, numStreams*sizeof fStreamStats[0]);
+  fNumStreamStats = numStreams;
+  __atomic_store_n(&fStatsSequence, fStatsSequence + 1, __ATOMIC_RELEASE);
+}
+
+int RTSPClientSessionData::getStreamStats(RTSPClientStreamStats* streamStats, int maxStreams) const {
+  int numStreams;
+  unsigned sequence;
+  do {
+    while ((sequence = __atomic_load_n(&fStatsSequence, __ATOMIC_ACQUIRE)) & 1) sched_yield();
+    numStreams = fNumStreamStats < maxStreams ? fNumStreamStats : maxStreams;
+    memcpy(streamStats, fStreamStats, numStreams*sizeof fStreamStats[0]);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (sequence != __atomic_load_n(&fStatsSequence, __ATOMIC_RELAXED));
+  return numStreams;
+}
+
 // Define a class to hold per-stream state that we maintain throughout each stream's lifetime:
 
 class StreamClientState {
@@ -110,12 +196,24 @@ public:
   StreamClientState();
   virtual ~StreamClientState();
 
+  void reset(); // closes "session" (if any), so that the stream can be set up again
+
 public:
   MediaSubsessionIterator* iter;
   MediaSession* session;
   MediaSubsession* subsession;
   TaskToken streamTimerTask;
   double duration;
+  Boolean streamUsingTCP;
+  TaskToken transportCheckTask;
+  unsigned numPacketsExpected, numPacketsReceived; // at the last transport check
+  unsigned numLossyChecks; // consecutive transport checks with too much packet loss
+  TaskToken streamStatsTask;
+  TaskToken jitterBufferTask;
+  unsigned jitterBufferUsecs[RTSPCLIENT_MAX_STREAMS]; // each subsession's current wait for missing packets (in iterator order)
+  unsigned numLatePackets[RTSPCLIENT_MAX_STREAMS]; // each subsession's late packets, at the last jitter buffer update
+  portNumBits poolPortNums[RTSPCLIENT_MAX_STREAMS]; // client port pairs that we took from "RTSPClientPortPool"
+  unsigned numPoolPortNums;
 };
 
 // If you're streaming just a single stream (i.e., just from a single URL, once), then you can define and use just a single
@@ -128,18 +226,69 @@ public:
   static ourRTSPClient* createNew(UsageEnvironment& env, char const* rtspURL,
                   int verbosityLevel = 0,
                   char const* applicationName = NULL,
-                  portNumBits tunnelOverHTTPPortNum = 0);
+                  portNumBits tunnelOverHTTPPortNum = 0,
+                  RTSPClientSessionData* sessionData = NULL);
 
 protected:
   ourRTSPClient(UsageEnvironment& env, char const* rtspURL,
-        int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum);
+        int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum,
+        RTSPClientSessionData* sessionData);
     // called only by createNew();
   virtual ~ourRTSPClient();
 
+public:
+  void resetConnection();
+    // closes the connection to the server, so that the stream can be set up again from "DESCRIBE"
+  void setVerbosityLevel(int verbosityLevel) { fVerbosityLevel = verbosityLevel; }
+  void traceStartup() { m_pTimeline->writeTrace(m_uiSessionId, fOrigURL); } // (see "rtspclient_timeline.h")
+
+protected:
+  // redefined virtual functions:
+  virtual int connectToServer(int socketNum, portNumBits remotePortNum);
+  virtual Boolean setRequestFields(RequestRecord* request,
+                                   char*& cmdURL, Boolean& cmdURLWasAllocated,
+                                   char const*& protocolStr,
+                                   char*& extraHeaders, Boolean& extraHeadersWereAllocated);
+
 public:
   StreamClientState scs;
   RTSPClient_CallBack* m_pRTSPClientCallBack;
   void *m_pvPri;
+  int m_iTransport;
+  unsigned int m_uiAutoTimeoutMs;
+  unsigned int m_uiAutoLossPercent;
+  Boolean m_bMulticast;
+  unsigned int m_uiRecvBufferBytes;
+  unsigned int m_uiReorderThresholdMs;
+  unsigned int m_uiJitterBufferMinMs;
+  unsigned int m_uiJitterBufferMaxMs;
+  Boolean m_bLowLatency;
+  char* m_pcTLSServerName; // non-NULL iff the URL was "rtsps://"
+  char* m_pcTLSCAFile;
+  RTSPClientFrameQueue* m_pFrameQueue; // pull mode only (owned by the "RTSPClientSession")
+  RTSPClientFrameBatcher* m_pFrameBatcher; // batch callback only
+  unsigned int m_uiMaxLatencyMs;
+
+  // Backpressure (set from the consumer's callback return values; see "DummySink::afterGettingFrame()"):
+  unsigned m_uiDropToKeyframeRequests; // each makes every video sink discard frames until its next keyframe
+  Boolean m_bSlowDown; // video sinks skip their disposable frames
+
+  TaskToken m_stopTask; // if the application stopped us from a frame callback: our shutdown, which we're waiting for
+
+  RTSPClientLogLimiter m_logLimiter; // for this stream's "STREAM_LOG()" lines
+
+  unsigned m_uiReconnects; // for "RTSPClientStreamStats"
+  RTSPClientLatencyHistogram* m_aLatency; // our session's (in "m_pSessionData")
+  RTSPClientLoopUsage* m_pLoopUsage; // the event loop's handler calls for us: our session's (in "m_pSessionData")
+  unsigned m_uiSessionId; // unique (in this process)
+  RTSPClientTimeline* m_pTimeline; // of our startup: our session's (in "m_pSessionData")
+
+  RTSPClientSessionData* m_pSessionData; // never NULL: our "RTSPClientSession"'s (or, if we have none, our own)
+      // (It's where our "RTSPClientStreamStats" are published.)
+
+private:
+  char* fOrigURL;
+  Boolean fOwnsSessionData;
 };
 
 // Define a data sink (a subclass of "MediaSink") to receive the data for each subsession (i.e., each audio or video 'substream').
@@ -147,17 +296,28 @@ public:
 // Or it might be a "FileSink", for outputting the received data into a file (as is done by the "openRTSP" application).
 // In this example code, however, we define a simple 'dummy' sink that receives incoming data, but does nothing with it.
 
+#define VIDEO_CODEC_OTHER   0
+#define VIDEO_CODEC_H264    1
+#define VIDEO_CODEC_H265    2
+
 class DummySink: public MediaSink {
 public:
   static DummySink* createNew(UsageEnvironment& env,
                   MediaSubsession& subsession, // identifies the kind of data that's being received
-                  char const* streamId = NULL); // identifies the stream itself (optional)
-  void printfHex(u_int8_t* data, int len);
+                  char const* streamId = NULL, // identifies the stream itself (optional)
+                  Boolean streamUsingTCP = False); // whether the stream's RTP packets come over the RTSP connection
   RTSPClient_CallBack* m_pRTSPClientCallBack;
   void *m_pvPri;
+  RTSPClientFrameQueue* m_pFrameQueue; // if non-NULL, frames go to this queue, rather than to "m_pRTSPClientCallBack"
+  RTSPClientFrameBatcher* m_pFrameBatcher; // otherwise, if non-NULL, frames go to this
+  int m_iStreamIndex; // as in "RTSPClientStreamStats"
+  ourRTSPClient* m_pRTSPClient; // our session
+
+  void takeStats(RTSPClientStreamStats& stats);
+      // fills in the counts of our frames - and the rates since the last call - and the callback times since the last call
 
 private:
-  DummySink(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId);
+  DummySink(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId, Boolean streamUsingTCP);
     // called only by "createNew()"
   virtual ~DummySink();
 
@@ -167,6 +327,12 @@ private:
                                 unsigned durationInMicroseconds);
   void afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
              struct timeval presentationTime, unsigned durationInMicroseconds);
+  void handleBackpressure(int result);
+  void countCallback(u_int64_t usecs) {
+    fCallbackUsecs += usecs;
+    ++fCallbacks;
+    if (usecs > fCallbackMaxUsecs) fCallbackMaxUsecs = (unsigned)usecs;
+  }
 
 private:
   // redefined virtual functions:
@@ -176,58 +342,137 @@ private:
   u_int8_t* fReceiveBuffer;
   MediaSubsession& fSubsession;
   char* fStreamId;
+  RTSPClientSRTPContext* fSRTPContext; // non-NULL iff the subsession's RTP packets are SRTP
+
+  // Backpressure:
+  int fVideoCodec; // VIDEO_CODEC_*; we discard frames only of video that we can find the keyframes of
+  Boolean fDroppingToKeyframe;
+  unsigned fDropToKeyframeRequestsSeen; // of our session's "m_uiDropToKeyframeRequests"
+  unsigned fFramesSkipped;
+
+  // Statistics (only the event loop uses these; "takeStats()" passes them on):
+  unsigned fFramesReceived, fFramesTruncated, fBytesTruncated;
+  u_int64_t fBytesReceived;
+  u_int64_t fCallbackUsecs; // since the last "takeStats()"
+  unsigned fCallbacks, fCallbackMaxUsecs; // ditto
+  u_int64_t fLastStatsUsecs; // when "takeStats()" was last called
+  unsigned fLastStatsFrames;
+  u_int64_t fLastStatsBytes;
 };
 
-#define RTSP_CLIENT_VERBOSITY_LEVEL 1 // by default, print verbose output from each "RTSPClient"
-
 static unsigned rtspClientCount = 0; // Counts how many streams (i.e., "RTSPClient"s) are currently in use.
+static unsigned frameDeliveryDepth = 0; // > 0 while a "DummySink" is handing a frame to the application
+static unsigned lastSessionId = 0; // the "m_uiSessionId" of the last "ourRTSPClient" created
+
+RTSPClient* openURL(UsageEnvironment& env, char const* progName, char const* rtspURL,
+                    RTSPClientInfo const* rtspClientInfo, int verbosityLevel, RTSPClientSessionData* sessionData) {
+  // A "rtsps://" URL is handled as the equivalent "rtsp://" URL, with the connection to the server made over TLS:
+  char* tlsServerName;
+  char* tlsURL = RTSPClientTLSConnection::convertRTSPSURL(rtspURL, tlsServerName);
+  if (tlsURL != NULL) rtspURL = tlsURL;
+
+  portNumBits tunnelOverHTTPPortNum = 0;
+  if (rtspClientInfo != NULL && rtspClientInfo->m_iTransport == RTSPC_TRANSPORT_HTTP && tlsURL == NULL) {
+    tunnelOverHTTPPortNum = rtspClientInfo->m_usHTTPTunnelPort != 0 ? rtspClientInfo->m_usHTTPTunnelPort : 80;
+  }
 
-RTSPClient* openURL(UsageEnvironment& env, char const* progName, char const* rtspURL) {
   // Begin by creating a "RTSPClient" object.  Note that there is a separate "RTSPClient" object for each stream that we wish
   // to receive (even if more than stream uses the same "rtsp://" URL).
-  env << "chenwenmin pid" << getpid() << " "  << __func__ << " " << __LINE__ << " chenwenmin : " << rtspURL << "\n";
-  RTSPClient* rtspClient = ourRTSPClient::createNew(env, rtspURL, RTSP_CLIENT_VERBOSITY_LEVEL, progName);
+  ourRTSPClient* rtspClient = ourRTSPClient::createNew(env, rtspURL, verbosityLevel, progName, tunnelOverHTTPPortNum, sessionData);
   if (rtspClient == NULL) {
-    env << "Failed to create a RTSP client for URL \"" << rtspURL << "\": " << env.getResultMsg() << "\n";
+    RTSPC_LOG(RTSPC_LOG_LEVEL_ERROR, NULL, "Failed to create a RTSP client for URL \"%s\": %s", rtspURL, env.getResultMsg());
+    delete[] tlsURL; delete[] tlsServerName;
     return NULL;
   }
+  delete[] tlsURL;
+  rtspClient->m_pcTLSServerName = tlsServerName;
+
+  if (rtspClientInfo != NULL) {
+    rtspClient->m_pRTSPClientCallBack = rtspClientInfo->m_pRTSPClientCallBack;
+    rtspClient->m_pvPri = rtspClientInfo->m_pvPri;
+    rtspClient->m_iTransport = rtspClientInfo->m_iTransport;
+    rtspClient->m_uiAutoTimeoutMs = rtspClientInfo->m_uiAutoTimeoutMs;
+    rtspClient->m_uiAutoLossPercent = rtspClientInfo->m_uiAutoLossPercent;
+    rtspClient->m_bMulticast = rtspClientInfo->m_bMulticast;
+    rtspClient->m_uiRecvBufferBytes = rtspClientInfo->m_uiRecvBufferBytes;
+    rtspClient->m_uiReorderThresholdMs = rtspClientInfo->m_uiReorderThresholdMs;
+    rtspClient->m_uiJitterBufferMinMs = rtspClientInfo->m_uiJitterBufferMinMs;
+    rtspClient->m_uiJitterBufferMaxMs = rtspClientInfo->m_uiJitterBufferMaxMs;
+    rtspClient->m_bLowLatency = rtspClientInfo->m_bLowLatency;
+    rtspClient->m_uiMaxLatencyMs = rtspClientInfo->m_uiMaxLatencyMs;
+    if (rtspClientInfo->m_cTLSCAFile[0] != '\0') rtspClient->m_pcTLSCAFile = strDup(rtspClientInfo->m_cTLSCAFile);
+    if (rtspClientInfo->m_pRTSPClientBatchCallBack != NULL && rtspClientInfo->m_uiFrameQueueFrames == 0) {
+      rtspClient->m_pFrameBatcher = new RTSPClientFrameBatcher(env, rtspClientInfo->m_uiBatchFrames, rtspClientInfo->m_uiBatchDelayUs,
+                                                               rtspClientInfo->m_pRTSPClientBatchCallBack, rtspClientInfo->m_pvPri,
+                                                               rtspClient->m_aLatency, rtspClient->m_pLoopUsage);
+    }
+  }
+  rtspClient->scs.streamUsingTCP = rtspClient->m_iTransport == RTSPC_TRANSPORT_TCP
+    || rtspClient->m_iTransport == RTSPC_TRANSPORT_HTTP;
 
   ++rtspClientCount;
 
   // Next, send a RTSP "DESCRIBE" command, to get a SDP description for the stream.
   // Note that this command - like all RTSP commands - is sent asynchronously; we do not block, waiting for a response.
   // Instead, the following function call returns immediately, and we handle the RTSP response later, from within the event loop:
-  env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
   rtspClient->sendDescribeCommand(continueAfterDESCRIBE);
 
   return rtspClient;
 }
 
 
+// The index of a subsession among those with a RTP source (i.e., in "RTSPClientStreamStats" order):
+static int streamIndexOf(StreamClientState& scs, MediaSubsession* subsession) {
+  int index = 0;
+  MediaSubsessionIterator iter(*scs.session);
+  MediaSubsession* s;
+  while ((s = iter.next()) != NULL && s != subsession) {
+    if (s->rtpSource() != NULL) ++index;
+  }
+  return index;
+}
+
 // Implementation of the RTSP 'response handlers':
 
+// How often the adaptive jitter buffer (see "jitterBufferHandler()") is resized:
+#define JITTER_BUFFER_INTERVAL_MSECS 250
+
+// How long a missing RTP packet is waited for (before the packets after it are passed on) - when the stream starts:
+static unsigned initialJitterBufferUsecs(ourRTSPClient* rtspClient) {
+  if (rtspClient->m_bLowLatency && !rtspClient->scs.streamUsingTCP) return 0;
+
+  unsigned thresholdMs = rtspClient->m_uiReorderThresholdMs;
+  if (rtspClient->m_uiJitterBufferMaxMs > 0) { // adaptive
+    if (thresholdMs < rtspClient->m_uiJitterBufferMinMs) thresholdMs = rtspClient->m_uiJitterBufferMinMs;
+    if (thresholdMs > rtspClient->m_uiJitterBufferMaxMs) thresholdMs = rtspClient->m_uiJitterBufferMaxMs;
+  }
+  return thresholdMs*1000;
+}
+
 void continueAfterDESCRIBE(RTSPClient* rtspClient, int resultCode, char* resultString) {
+  ((ourRTSPClient*)rtspClient)->m_pTimeline->end(RTSPC_PHASE_DESCRIBE);
+  RTSPCLIENT_PROBE3(describe, ((ourRTSPClient*)rtspClient)->m_uiSessionId, resultCode, rtspClient->url());
   do {
     UsageEnvironment& env = rtspClient->envir(); // alias
     StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
     if (resultCode != 0) {
-      env << *rtspClient << "Failed to get a SDP description: " << resultString << "\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to get a SDP description: %s", resultString);
       delete[] resultString;
       break;
     }
 
     char* const sdpDescription = resultString;
-    env << *rtspClient << "Got a SDP description:\n" << sdpDescription << "\n";
+    STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Got a SDP description");
 
     // Create a media session object from this SDP description:
     scs.session = MediaSession::createNew(env, sdpDescription);
     delete[] sdpDescription; // because we don't need it anymore
     if (scs.session == NULL) {
-      env << *rtspClient << "Failed to create a MediaSession object from the SDP description: " << env.getResultMsg() << "\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to create a MediaSession object from the SDP description: %s",
+                 env.getResultMsg());
       break;
     } else if (!scs.session->hasSubsessions()) {
-      env << *rtspClient << "This session has no media subsessions (i.e., no \"m=\" lines)\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "This session has no media subsessions (i.e., no \"m=\" lines)");
       break;
     }
 
@@ -236,7 +481,6 @@ void continueAfterDESCRIBE(RTSPClient* rtspClient, int resultCode, char* resultS
     // (Each 'subsession' will have its own data source.)
     scs.iter = new MediaSubsessionIterator(*scs.session);
     setupNextSubsession(rtspClient);
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
     return;
   } while (0);
 
@@ -244,31 +488,70 @@ void continueAfterDESCRIBE(RTSPClient* rtspClient, int resultCode, char* resultS
   shutdownStream(rtspClient);
 }
 
-// By default, we request that the server stream its data using RTP/UDP.
-// If, instead, you want to request that the server stream via RTP-over-TCP, change the following to True:
-#define REQUEST_STREAMING_OVER_TCP False
+// Whether we request that the server stream its data using RTP/UDP or RTP-over-TCP is chosen per stream
+// (see "RTSPClientInfo::m_iTransport"), and kept in "StreamClientState::streamUsingTCP".
+
+// The number of port pairs from "RTSPClientPortPool" that we try (when binding fails) before using ephemeral ports:
+#define PORT_POOL_MAX_TRIES 8
+
+// Initiates a subsession - for unicast RTP-over-UDP, using a client port pair from "RTSPClientPortPool", if one is configured:
+static Boolean initiateSubsession(RTSPClient* rtspClient, MediaSubsession* subsession) {
+  StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
+
+  if (!scs.streamUsingTCP && !((ourRTSPClient*)rtspClient)->m_bMulticast
+      && !IsMulticastAddress(subsession->connectionEndpointAddress()) && scs.numPoolPortNums < RTSPCLIENT_MAX_STREAMS) {
+    for (unsigned i = 0; i < PORT_POOL_MAX_TRIES; ++i) {
+      portNumBits portNum = RTSPClientPortPool::allocate();
+      if (portNum == 0) break; // no pool, or it's empty
+
+      subsession->setClientPortNum(portNum);
+      Boolean initiated;
+      {
+        NoReuse dontReuse(rtspClient->envir()); // so that binding fails if someone else already has the port
+        initiated = subsession->initiate();
+      }
+      // ("initiate()" succeeds even if a socket for a given port couldn't be bound, so check this ourself:)
+      if (initiated && (subsession->rtpSource() == NULL || subsession->rtpSource()->RTPgs()->socketNum() < 0
+                        || (subsession->rtcpInstance() != NULL && subsession->rtcpInstance()->RTCPgs()->socketNum() < 0))) {
+        subsession->deInitiate();
+        initiated = False;
+      }
+      if (initiated) {
+        scs.poolPortNums[scs.numPoolPortNums++] = portNum;
+        return True;
+      }
+      // The pair is in use by someone else.  Move it to the end of the free list, and try the next one:
+      RTSPClientPortPool::release(portNum);
+    }
+    subsession->setClientPortNum(0);
+  }
+
+  return subsession->initiate();
+}
 
 void setupNextSubsession(RTSPClient* rtspClient) {
   UsageEnvironment& env = rtspClient->envir(); // alias
   StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
   scs.subsession = scs.iter->next();
   if (scs.subsession != NULL) {
-    if (!scs.subsession->initiate()) {
-      env << *rtspClient << "Failed to initiate the \"" << *scs.subsession << "\" subsession: " << env.getResultMsg() << "\n";
+    if (!initiateSubsession(rtspClient, scs.subsession)) {
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to initiate the \"%s/%s\" subsession: %s",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), env.getResultMsg());
       setupNextSubsession(rtspClient); // give up on this subsession; go to the next one
     } else {
-      env << *rtspClient << "Initiated the \"" << *scs.subsession << "\" subsession (";
       if (scs.subsession->rtcpIsMuxed()) {
-    env << "client port " << scs.subsession->clientPortNum();
+        STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Initiated the \"%s/%s\" subsession (client port %u)",
+                   scs.subsession->mediumName(), scs.subsession->codecName(), scs.subsession->clientPortNum());
       } else {
-    env << "client ports " << scs.subsession->clientPortNum() << "-" << scs.subsession->clientPortNum()+1;
+        STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Initiated the \"%s/%s\" subsession (client ports %u-%u)",
+                   scs.subsession->mediumName(), scs.subsession->codecName(), scs.subsession->clientPortNum(),
+                   scs.subsession->clientPortNum()+1);
       }
-      env << ")\n";
 
       // Continue setting up this subsession, by sending a RTSP "SETUP" command:
-      env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
-      rtspClient->sendSetupCommand(*scs.subsession, continueAfterSETUP, False, REQUEST_STREAMING_OVER_TCP);
+      // (If multicast was asked for, let the server choose the multicast group when the SDP description doesn't specify one.)
+      Boolean forceMulticastOnUnspecified = ((ourRTSPClient*)rtspClient)->m_bMulticast && !scs.streamUsingTCP;
+      rtspClient->sendSetupCommand(*scs.subsession, continueAfterSETUP, False, scs.streamUsingTCP, forceMulticastOnUnspecified);
     }
     return;
   }
@@ -283,46 +566,148 @@ void setupNextSubsession(RTSPClient* rtspClient) {
   }
 }
 
+// Attributes the event loop's calls of a socket's handler to the session (NULL: to none); see "rtspclient_scheduler.h":
+static void setSocketOwner(UsageEnvironment& env, int socketNum, ourRTSPClient* rtspClient,
+                           RTSPClientTaskScheduler::HandlerType type) {
+  RTSPClientTaskScheduler& scheduler = (RTSPClientTaskScheduler&)env.taskScheduler(); // alias
+  scheduler.setSocketOwner(socketNum, rtspClient == NULL ? NULL : rtspClient->m_pLoopUsage, type);
+}
+
+// Attributes the event loop's handler call that's in progress (e.g., a timer's) to the session:
+static void attributeToSession(ourRTSPClient* rtspClient) {
+  ((RTSPClientTaskScheduler&)rtspClient->envir().taskScheduler()).setCurrentOwner(rtspClient->m_pLoopUsage);
+}
+
+// Sets SO_REUSEADDR (and SO_REUSEPORT, if we have it) on a socket that receives a multicast group.
+// (Groupsocks already set these when they're created, unless "NoReuse" is in effect; we make sure of it here,
+//  because other receivers of the same group can bind to its port only if all of its sockets allow this.)
+static void allowSocketReuse(int socketNum) {
+  int reuseFlag = 1;
+  if (setsockopt(socketNum, SOL_SOCKET, SO_REUSEADDR, (const char*)&reuseFlag, sizeof reuseFlag) < 0) {
+    return;
+  }
+#ifdef SO_REUSEPORT
+  setsockopt(socketNum, SOL_SOCKET, SO_REUSEPORT, (const char*)&reuseFlag, sizeof reuseFlag);
+#endif
+}
+
+// Receive buffer sizing for RTP-over-UDP sockets.  If not configured, we buffer this much of the SDP's bitrate, so that
+// a burst (e.g., a large IDR frame) survives while the event loop is busy elsewhere:
+#define RECV_BUFFER_MSECS_OF_BITRATE 1000
+#define RECV_BUFFER_MIN_BYTES (256*1024)
+#define RECV_BUFFER_MAX_BYTES (8*1024*1024)
+#define RECV_BUFFER_DEFAULT_VIDEO_BYTES (2*1024*1024) // if the SDP has no bitrate ("b=") line
+
+static void setRTPReceiveBuffer(UsageEnvironment& env, MediaSubsession* subsession, unsigned configuredBytes) {
+  if (subsession->rtpSource() == NULL) return;
+
+  int socketNum = subsession->rtpSource()->RTPgs()->socketNum();
+  if (configuredBytes > 0) {
+    setReceiveBufferTo(env, socketNum, configuredBytes);
+    return;
+  }
+
+  unsigned bufferBytes = 0;
+  if (subsession->bandwidth() > 0) { // kbps
+    bufferBytes = subsession->bandwidth()*RECV_BUFFER_MSECS_OF_BITRATE/8;
+  } else if (strcmp(subsession->mediumName(), "video") == 0) {
+    bufferBytes = RECV_BUFFER_DEFAULT_VIDEO_BYTES;
+  }
+  if (bufferBytes < RECV_BUFFER_MIN_BYTES) bufferBytes = RECV_BUFFER_MIN_BYTES;
+  if (bufferBytes > RECV_BUFFER_MAX_BYTES) bufferBytes = RECV_BUFFER_MAX_BYTES;
+
+  // (This gets as close as it can, if "bufferBytes" is more than the kernel allows - i.e., "net.core.rmem_max".)
+  increaseReceiveBufferTo(env, socketNum, bufferBytes);
+}
+
 void continueAfterSETUP(RTSPClient* rtspClient, int resultCode, char* resultString) {
+  ((ourRTSPClient*)rtspClient)->m_pTimeline->endSetup();
   do {
     UsageEnvironment& env = rtspClient->envir(); // alias
     StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
-    env << "chenwenmin pid" << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " " << __func__ << ":" <<__LINE__ << "\n";
+    RTSPCLIENT_PROBE5(setup, ((ourRTSPClient*)rtspClient)->m_uiSessionId, resultCode, scs.subsession->mediumName(),
+                      scs.subsession->codecName(),
+                      !scs.streamUsingTCP && scs.subsession->rtpSource() != NULL ? scs.subsession->rtpSource()->RTPgs()->socketNum() : -1);
     if (resultCode != 0) {
-      env << *rtspClient << "Failed to set up the \"" << *scs.subsession << "\" subsession: " << resultString << "\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to set up the \"%s/%s\" subsession: %s",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), resultString);
       break;
     }
 
-    env << *rtspClient << "Set up the \"" << *scs.subsession << "\" subsession (";
     if (scs.subsession->rtcpIsMuxed()) {
-      env << "client port " << scs.subsession->clientPortNum();
+      STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Set up the \"%s/%s\" subsession (client port %u)",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), scs.subsession->clientPortNum());
+    } else {
+      STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Set up the \"%s/%s\" subsession (client ports %u-%u)",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), scs.subsession->clientPortNum(),
+                 scs.subsession->clientPortNum()+1);
+    }
+
+    if (!scs.streamUsingTCP && IsMulticastAddress(scs.subsession->connectionEndpointAddress())) {
+      // The stream is multicast.  Make sure that other local receivers (e.g., in other processes) can also bind to
+      // the group's port(s), so that they all share the one network stream:
+      if (scs.subsession->rtpSource() != NULL) {
+        allowSocketReuse(scs.subsession->rtpSource()->RTPgs()->socketNum());
+      }
+      if (scs.subsession->rtcpInstance() != NULL) {
+        allowSocketReuse(scs.subsession->rtcpInstance()->RTCPgs()->socketNum());
+      }
+      STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Receiving the \"%s/%s\" subsession from multicast group %s",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), scs.subsession->connectionEndpointName());
+    }
+
+    unsigned reorderThresholdUsecs = initialJitterBufferUsecs((ourRTSPClient*)rtspClient);
+    if (!scs.streamUsingTCP) {
+      setRTPReceiveBuffer(env, scs.subsession, ((ourRTSPClient*)rtspClient)->m_uiRecvBufferBytes);
+      if (scs.subsession->rtcpInstance() != NULL) {
+        setSocketOwner(env, scs.subsession->rtcpInstance()->RTCPgs()->socketNum(), (ourRTSPClient*)rtspClient,
+                       RTSPClientTaskScheduler::MEDIA_HANDLER);
+      }
+      if (scs.subsession->rtpSource() != NULL) {
+        // Read the RTP packets in batches, and (unless we're in low-latency mode) put them back in order as they're read
+        // (see "rtspclient_batch.h").  live555's own (slower) reordering then has nothing to do:
+        int socketNum = scs.subsession->rtpSource()->RTPgs()->socketNum();
+        setSocketOwner(env, socketNum, (ourRTSPClient*)rtspClient, RTSPClientTaskScheduler::MEDIA_HANDLER);
+        if (RTSPClientBatchReader::enable(socketNum) && reorderThresholdUsecs > 0
+            && RTSPClientBatchReader::setReordering(socketNum, reorderThresholdUsecs, ((ourRTSPClient*)rtspClient)->m_uiSessionId,
+                                                    streamIndexOf(scs, scs.subsession))) {
+          reorderThresholdUsecs = 0;
+        }
+      }
     } else {
-      env << "client ports " << scs.subsession->clientPortNum() << "-" << scs.subsession->clientPortNum()+1;
+      // The RTP (and RTCP) packets will be interleaved on the RTSP connection; read it in large chunks (see "rtspclient_batch.h"):
+      RTSPClientBatchReader::enableStream(rtspClient->socketNum());
+      setSocketOwner(env, rtspClient->socketNum(), (ourRTSPClient*)rtspClient, RTSPClientTaskScheduler::MEDIA_HANDLER);
+    }
+    if (scs.subsession->rtpSource() != NULL) {
+      scs.subsession->rtpSource()->setPacketReorderingThresholdTime(reorderThresholdUsecs);
     }
-    env << ")\n";
 
     // Having successfully setup the subsession, create a data sink for it, and call "startPlaying()" on it.
     // (This will prepare the data sink to receive data; the actual flow of data from the client won't start happening until later,
     // after we've sent a RTSP "PLAY" command.)
 
-    scs.subsession->sink = DummySink::createNew(env, *scs.subsession, rtspClient->url());
+    scs.subsession->sink = DummySink::createNew(env, *scs.subsession, rtspClient->url(), scs.streamUsingTCP);
       // perhaps use your own custom "MediaSink" subclass instead
     if (scs.subsession->sink == NULL) {
-      env << *rtspClient << "Failed to create a data sink for the \"" << *scs.subsession
-      << "\" subsession: " << env.getResultMsg() << "\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to create a data sink for the \"%s/%s\" subsession: %s",
+                 scs.subsession->mediumName(), scs.subsession->codecName(), env.getResultMsg());
       break;
     }
 
     ((DummySink *)(scs.subsession->sink))->m_pRTSPClientCallBack = ((ourRTSPClient*)rtspClient)->m_pRTSPClientCallBack;
     ((DummySink *)(scs.subsession->sink))->m_pvPri = ((ourRTSPClient*)rtspClient)->m_pvPri;
+    ((DummySink *)(scs.subsession->sink))->m_pFrameQueue = ((ourRTSPClient*)rtspClient)->m_pFrameQueue;
+    ((DummySink *)(scs.subsession->sink))->m_pFrameBatcher = ((ourRTSPClient*)rtspClient)->m_pFrameBatcher;
+    ((DummySink *)(scs.subsession->sink))->m_iStreamIndex = streamIndexOf(scs, scs.subsession);
+    ((DummySink *)(scs.subsession->sink))->m_pRTSPClient = (ourRTSPClient*)rtspClient;
 
-    env << *rtspClient << "Created a data sink for the \"" << *scs.subsession << "\" subsession\n";
+    STREAM_LOG(RTSPC_LOG_LEVEL_DEBUG, rtspClient, "Created a data sink for the \"%s/%s\" subsession",
+               scs.subsession->mediumName(), scs.subsession->codecName());
     scs.subsession->miscPtr = rtspClient; // a hack to let subsession handler functions get the "RTSPClient" from the subsession
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
     scs.subsession->sink->startPlaying(*(scs.subsession->readSource()),
                        subsessionAfterPlaying, scs.subsession);
     // Also set a handler to be called if a RTCP "BYE" arrives for this subsession:
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << "\n";
     if (scs.subsession->rtcpInstance() != NULL) {
       scs.subsession->rtcpInstance()->setByeWithReasonHandler(subsessionByeHandler, scs.subsession);
     }
@@ -335,13 +720,15 @@ void continueAfterSETUP(RTSPClient* rtspClient, int resultCode, char* resultStri
 
 void continueAfterPLAY(RTSPClient* rtspClient, int resultCode, char* resultString) {
   Boolean success = False;
+  ((ourRTSPClient*)rtspClient)->m_pTimeline->end(RTSPC_PHASE_PLAY);
+  RTSPCLIENT_PROBE2(play, ((ourRTSPClient*)rtspClient)->m_uiSessionId, resultCode);
 
   do {
     UsageEnvironment& env = rtspClient->envir(); // alias
     StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
 
     if (resultCode != 0) {
-      env << *rtspClient << "Failed to start playing session: " << resultString << "\n";
+      STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Failed to start playing session: %s", resultString);
       break;
     }
 
@@ -356,11 +743,33 @@ void continueAfterPLAY(RTSPClient* rtspClient, int resultCode, char* resultStrin
       scs.streamTimerTask = env.taskScheduler().scheduleDelayedTask(uSecsToDelay, (TaskFunc*)streamTimerHandler, rtspClient);
     }
 
-    env << "chenwenmin pid " << getpid() << " "  << __func__ << ":" <<__LINE__ << " " << *rtspClient << "Started playing session";
+    // If we're allowed to fall back to RTP-over-TCP, check (after a while) that data is actually arriving over UDP:
+    if (((ourRTSPClient*)rtspClient)->m_iTransport == RTSPC_TRANSPORT_AUTO && !scs.streamUsingTCP) {
+      scs.numPacketsExpected = scs.numPacketsReceived = scs.numLossyChecks = 0;
+      unsigned uSecsToDelay = ((ourRTSPClient*)rtspClient)->m_uiAutoTimeoutMs*1000;
+      scs.transportCheckTask = env.taskScheduler().scheduleDelayedTask(uSecsToDelay, (TaskFunc*)transportCheckHandler, rtspClient);
+    }
+
+    // Start each subsession's jitter buffer at its initial size, then (if it's adaptive) keep it sized to the measured jitter:
+    for (unsigned i = 0; i < RTSPCLIENT_MAX_STREAMS; ++i) {
+      scs.jitterBufferUsecs[i] = scs.streamUsingTCP ? 0 : initialJitterBufferUsecs((ourRTSPClient*)rtspClient);
+      scs.numLatePackets[i] = 0;
+    }
+    env.taskScheduler().unscheduleDelayedTask(scs.jitterBufferTask);
+    if (((ourRTSPClient*)rtspClient)->m_uiJitterBufferMaxMs > 0 && scs.jitterBufferUsecs[0] > 0) {
+      scs.jitterBufferTask = env.taskScheduler().scheduleDelayedTask(JITTER_BUFFER_INTERVAL_MSECS*1000,
+                                                                     (TaskFunc*)jitterBufferHandler, rtspClient);
+    }
+
+    // Keep the stream's statistics up to date:
+    env.taskScheduler().unscheduleDelayedTask(scs.streamStatsTask);
+    streamStatsHandler(rtspClient);
+
     if (scs.duration > 0) {
-      env << " (for up to " << scs.duration << " seconds)";
+      STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Started playing session (for up to %f seconds)...", scs.duration);
+    } else {
+      STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Started playing session...");
     }
-    env << "...\n";
 
     success = True;
   } while (0);
@@ -397,14 +806,14 @@ void subsessionAfterPlaying(void* clientData) {
 void subsessionByeHandler(void* clientData, char const* reason) {
   MediaSubsession* subsession = (MediaSubsession*)clientData;
   RTSPClient* rtspClient = (RTSPClient*)subsession->miscPtr;
-  UsageEnvironment& env = rtspClient->envir(); // alias
-
-  env << "chenwenmin pid" << getpid() << " "  << __func__ << ":" <<__LINE__ << " " << *rtspClient << "Received RTCP \"BYE\"";
   if (reason != NULL) {
-    env << " (reason:\"" << reason << "\")";
+    STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Received RTCP \"BYE\" (reason:\"%s\") on \"%s/%s\" subsession",
+               reason, subsession->mediumName(), subsession->codecName());
     delete[] (char*)reason;
+  } else {
+    STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Received RTCP \"BYE\" on \"%s/%s\" subsession",
+               subsession->mediumName(), subsession->codecName());
   }
-  env << " on \"" << *subsession << "\" subsession\n";
 
   // Now act as if the subsession had closed:
   subsessionAfterPlaying(subsession);
@@ -413,6 +822,7 @@ void subsessionByeHandler(void* clientData, char const* reason) {
 void streamTimerHandler(void* clientData) {
   ourRTSPClient* rtspClient = (ourRTSPClient*)clientData;
   StreamClientState& scs = rtspClient->scs; // alias
+  attributeToSession(rtspClient);
 
   scs.streamTimerTask = NULL;
 
@@ -420,9 +830,245 @@ void streamTimerHandler(void* clientData) {
   shutdownStream(rtspClient);
 }
 
-void shutdownStream(RTSPClient* rtspClient, int exitCode) {
+// The number of consecutive transport checks with too much packet loss, before we give up on UDP:
+#define TRANSPORT_CHECK_MAX_LOSSY 3
+
+void transportCheckHandler(void* clientData) {
+  ourRTSPClient* rtspClient = (ourRTSPClient*)clientData;
+  StreamClientState& scs = rtspClient->scs; // alias
+  attributeToSession(rtspClient);
+
+  scs.transportCheckTask = NULL;
+  if (scs.session == NULL) return; // sanity check (should not happen)
+
+  // Count the RTP packets that we've expected and received (so far) on all subsessions:
+  unsigned numPacketsExpected = 0, numPacketsReceived = 0;
+  MediaSubsessionIterator iter(*scs.session);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL) {
+    if (subsession->rtpSource() == NULL) continue;
+
+    RTPReceptionStatsDB::Iterator statsIter(subsession->rtpSource()->receptionStatsDB());
+    RTPReceptionStats* stats;
+    while ((stats = statsIter.next(True)) != NULL) {
+      numPacketsExpected += stats->totNumPacketsExpected();
+      numPacketsReceived += stats->totNumPacketsReceived();
+    }
+  }
+
+  if (numPacketsReceived == 0) {
+    // Nothing arrived before the deadline; UDP is probably blocked:
+    restartStreamOverTCP(rtspClient);
+    return;
+  }
+
+  unsigned deltaExpected = numPacketsExpected - scs.numPacketsExpected;
+  unsigned deltaReceived = numPacketsReceived - scs.numPacketsReceived;
+  if (deltaExpected > deltaReceived
+      && (deltaExpected - deltaReceived)*100 > rtspClient->m_uiAutoLossPercent*deltaExpected) {
+    ++scs.numLossyChecks;
+  } else {
+    scs.numLossyChecks = 0;
+  }
+  scs.numPacketsExpected = numPacketsExpected;
+  scs.numPacketsReceived = numPacketsReceived;
+
+  if (scs.numLossyChecks >= TRANSPORT_CHECK_MAX_LOSSY) {
+    restartStreamOverTCP(rtspClient);
+    return;
+  }
+
+  UsageEnvironment& env = rtspClient->envir(); // alias
+  scs.transportCheckTask = env.taskScheduler().scheduleDelayedTask(rtspClient->m_uiAutoTimeoutMs*1000,
+                                                                   (TaskFunc*)transportCheckHandler, rtspClient);
+}
+
+// "SO_MEMINFO" (Linux 4.6+) returns - amongst other things - the number of packets that the kernel has dropped for the socket
+// (this is the same counter as "SO_RXQ_OVFL" reports, but it doesn't need "recvmsg()").  Older toolchains lack the definitions:
+#ifndef SO_MEMINFO
+#define SO_MEMINFO 55
+#endif
+#define SK_MEMINFO_DROPS_INDEX 8
+#define SK_MEMINFO_NUM_VARS 9
+
+static unsigned kernelDropsOnSocket(int socketNum) {
+  u_int32_t memInfo[SK_MEMINFO_NUM_VARS];
+  socklen_t len = sizeof memInfo;
+  if (getsockopt(socketNum, SOL_SOCKET, SO_MEMINFO, memInfo, &len) < 0 || len <= SK_MEMINFO_DROPS_INDEX*sizeof memInfo[0]) {
+    return 0; // not supported by this kernel
+  }
+  return memInfo[SK_MEMINFO_DROPS_INDEX];
+}
+
+// The interarrival jitter (RFC 3550, section 6.4.1) of a RTP source's packets, in microseconds (the largest, if there are several SSRCs):
+static unsigned jitterUsecs(RTPSource* rtpSource) {
+  unsigned timestampFrequency = rtpSource->timestampFrequency();
+  if (timestampFrequency == 0) return 0;
+
+  unsigned maxJitter = 0;
+  RTPReceptionStatsDB::Iterator statsIter(rtpSource->receptionStatsDB());
+  RTPReceptionStats* receptionStats;
+  while ((receptionStats = statsIter.next(True)) != NULL) {
+    if (receptionStats->jitter() > maxJitter) maxJitter = receptionStats->jitter();
+  }
+  return (unsigned)((maxJitter*1000000ULL)/timestampFrequency);
+}
+
+#define STREAM_STATS_INTERVAL_MSECS 1000
+
+void streamStatsHandler(void* clientData) {
+  ourRTSPClient* rtspClient = (ourRTSPClient*)clientData;
+  StreamClientState& scs = rtspClient->scs; // alias
+  attributeToSession(rtspClient);
+
+  scs.streamStatsTask = NULL;
+  if (scs.session == NULL) return; // sanity check (should not happen)
+
+  RTSPClientStreamStats streamStats[RTSPCLIENT_MAX_STREAMS];
+  int numStreams = 0;
+  MediaSubsessionIterator iter(*scs.session);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL && numStreams < RTSPCLIENT_MAX_STREAMS) {
+    if (subsession->rtpSource() == NULL) continue;
+
+    RTSPClientStreamStats& stats = streamStats[numStreams++];
+    memset(&stats, 0, sizeof stats);
+    snprintf(stats.m_cMediumName, sizeof stats.m_cMediumName, "%s", subsession->mediumName());
+    snprintf(stats.m_cCodecName, sizeof stats.m_cCodecName, "%s", subsession->codecName());
+
+    RTPReceptionStatsDB::Iterator statsIter(subsession->rtpSource()->receptionStatsDB());
+    RTPReceptionStats* receptionStats;
+    while ((receptionStats = statsIter.next(True)) != NULL) {
+      unsigned numExpected = receptionStats->totNumPacketsExpected();
+      unsigned numReceived = receptionStats->totNumPacketsReceived();
+      stats.m_uiPacketsExpected += numExpected;
+      stats.m_uiPacketsReceived += numReceived;
+      if (numExpected > numReceived) stats.m_uiPacketsLost += numExpected - numReceived;
+      if (numReceived > 1) {
+        struct timeval const& totalGaps = receptionStats->totalInterPacketGaps();
+        stats.m_uiAvgPacketGapUs = (unsigned)((totalGaps.tv_sec*(u_int64_t)1000000 + totalGaps.tv_usec)/(numReceived - 1));
+      }
+      if (receptionStats->maxInterPacketGapUS() > stats.m_uiMaxPacketGapUs) stats.m_uiMaxPacketGapUs = receptionStats->maxInterPacketGapUS();
+    }
+
+    if (!scs.streamUsingTCP) {
+      int socketNum = subsession->rtpSource()->RTPgs()->socketNum();
+      stats.m_uiRecvBufferBytes = getReceiveBufferSize(rtspClient->envir(), socketNum);
+      stats.m_uiKernelDrops = kernelDropsOnSocket(socketNum);
+      RTSPClientReorderRing const* reorderRing = RTSPClientBatchReader::reorderRing(socketNum);
+      if (reorderRing != NULL) {
+        stats.m_uiPacketsReordered = reorderRing->numPacketsReordered();
+        stats.m_uiJitterBufferPackets = reorderRing->numPacketsHeld();
+      }
+    }
+    stats.m_uiJitterUs = jitterUsecs(subsession->rtpSource());
+    stats.m_uiJitterBufferUs = scs.jitterBufferUsecs[numStreams-1];
+    stats.m_uiNetworkLost = stats.m_uiPacketsLost > stats.m_uiKernelDrops ? stats.m_uiPacketsLost - stats.m_uiKernelDrops : 0;
+    if (subsession->sink != NULL) ((DummySink*)subsession->sink)->takeStats(stats);
+    if (rtspClient->m_pFrameQueue != NULL) {
+      stats.m_uiQueuedFrames = rtspClient->m_pFrameQueue->numQueued();
+      stats.m_uiFramesDropped = rtspClient->m_pFrameQueue->numDropped();
+    }
+    stats.m_uiReconnects = rtspClient->m_uiReconnects;
+    RTSPCLIENT_PROBE5(loss, rtspClient->m_uiSessionId, numStreams - 1, stats.m_uiPacketsExpected, stats.m_uiPacketsLost,
+                      stats.m_uiKernelDrops);
+  }
+
+  if (rtspClient->m_pSessionData->rtspClient() == rtspClient) { // (else we've been stopped, and are about to be closed)
+    rtspClient->m_pSessionData->publishStreamStats(streamStats, numStreams);
+  }
+
+  UsageEnvironment& env = rtspClient->envir(); // alias
+  scs.streamStatsTask = env.taskScheduler().scheduleDelayedTask(STREAM_STATS_INTERVAL_MSECS*1000,
+                                                                (TaskFunc*)streamStatsHandler, rtspClient);
+}
+
+// The adaptive jitter buffer.  Each subsession waits (for a missing RTP packet) for a multiple of the measured jitter, within
+// "m_uiJitterBufferMinMs".."m_uiJitterBufferMaxMs".  The wait grows at once (and by half again whenever packets have arrived after
+// we'd given up on them), but shrinks only gradually:
+#define JITTER_BUFFER_JITTER_MULTIPLE 4
+#define JITTER_BUFFER_SHRINK_SHIFT 3 // i.e., shrink by 1/8 of the difference, each interval
+
+void jitterBufferHandler(void* clientData) {
+  ourRTSPClient* rtspClient = (ourRTSPClient*)clientData;
+  StreamClientState& scs = rtspClient->scs; // alias
+  attributeToSession(rtspClient);
+
+  scs.jitterBufferTask = NULL;
+  if (scs.session == NULL) return; // sanity check (should not happen)
+
+  unsigned const minUsecs = rtspClient->m_uiJitterBufferMinMs*1000;
+  unsigned const maxUsecs = rtspClient->m_uiJitterBufferMaxMs*1000;
+  unsigned i = 0;
+  MediaSubsessionIterator iter(*scs.session);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL && i < RTSPCLIENT_MAX_STREAMS) {
+    if (subsession->rtpSource() == NULL) continue;
+
+    unsigned& bufferUsecs = scs.jitterBufferUsecs[i];
+    unsigned targetUsecs = jitterUsecs(subsession->rtpSource())*JITTER_BUFFER_JITTER_MULTIPLE;
+    RTSPClientReorderRing* reorderRing = RTSPClientBatchReader::reorderRing(subsession->rtpSource()->RTPgs()->socketNum());
+    if (reorderRing != NULL && reorderRing->numPacketsLate() != scs.numLatePackets[i]) {
+      // We gave up too soon on some packets:
+      scs.numLatePackets[i] = reorderRing->numPacketsLate();
+      if (targetUsecs < bufferUsecs + bufferUsecs/2) targetUsecs = bufferUsecs + bufferUsecs/2;
+    }
+    if (targetUsecs < minUsecs) targetUsecs = minUsecs;
+    if (targetUsecs > maxUsecs) targetUsecs = maxUsecs;
+
+    if (targetUsecs >= bufferUsecs) {
+      bufferUsecs = targetUsecs;
+    } else {
+      bufferUsecs -= (bufferUsecs - targetUsecs + (1<<JITTER_BUFFER_SHRINK_SHIFT) - 1)>>JITTER_BUFFER_SHRINK_SHIFT;
+    }
+    if (bufferUsecs == 0) bufferUsecs = 1; // 0 would mean 'no reordering' to live555
+
+    if (reorderRing != NULL) {
+      reorderRing->setThresholdUsecs(bufferUsecs);
+    } else {
+      subsession->rtpSource()->setPacketReorderingThresholdTime(bufferUsecs);
+    }
+    ++i;
+  }
+
   UsageEnvironment& env = rtspClient->envir(); // alias
+  scs.jitterBufferTask = env.taskScheduler().scheduleDelayedTask(JITTER_BUFFER_INTERVAL_MSECS*1000,
+                                                                 (TaskFunc*)jitterBufferHandler, rtspClient);
+}
+
+void restartStreamOverTCP(RTSPClient* rtspClient) {
+  StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
+
+  STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, rtspClient, "Switching the stream to RTP-over-TCP");
+  ++((ourRTSPClient*)rtspClient)->m_uiReconnects;
+
+  // Close the subsessions' sinks, and tell the server to stop streaming over UDP:
+  MediaSubsessionIterator iter(*scs.session);
+  MediaSubsession* subsession;
+  while ((subsession = iter.next()) != NULL) {
+    if (subsession->sink != NULL) {
+      Medium::close(subsession->sink);
+      subsession->sink = NULL;
+
+      if (subsession->rtcpInstance() != NULL) {
+        subsession->rtcpInstance()->setByeHandler(NULL, NULL);
+      }
+    }
+  }
+  rtspClient->sendTeardownCommand(*scs.session, NULL);
+
+  // Drop the connection (and with it the server's session), and our own media session:
+  ((ourRTSPClient*)rtspClient)->resetConnection();
+  scs.reset();
+
+  // Then set the stream up again, from the start:
+  scs.streamUsingTCP = True;
+  rtspClient->sendDescribeCommand(continueAfterDESCRIBE);
+}
+
+void shutdownStream(RTSPClient* rtspClient, int exitCode) {
   StreamClientState& scs = ((ourRTSPClient*)rtspClient)->scs; // alias
+  RTSPCLIENT_PROBE2(shutdown, ((ourRTSPClient*)rtspClient)->m_uiSessionId, exitCode);
 
   // First, check whether any subsessions have still to be closed:
   if (scs.session != NULL) {
@@ -430,7 +1076,6 @@ void shutdownStream(RTSPClient* rtspClient, int exitCode) {
     MediaSubsessionIterator iter(*scs.session);
     MediaSubsession* subsession;
     while ((subsession = iter.next()) != NULL) {
-        env << "chenwenmin pid" << getpid() << " "  << __func__ << ":"<< __LINE__ << " iter " << ".\n";
       if (subsession->sink != NULL) {
     Medium::close(subsession->sink);
     subsession->sink = NULL;
@@ -450,158 +1095,417 @@ void shutdownStream(RTSPClient* rtspClient, int exitCode) {
     }
   }
 
+  if (((ourRTSPClient *)rtspClient)->m_pFrameQueue != NULL) {
+    ((ourRTSPClient *)rtspClient)->m_pFrameQueue->close(); // consumers get the frames already queued, then -1
+    ((ourRTSPClient *)rtspClient)->m_pFrameQueue = NULL; // (it's the session's; once we've left it, the session may delete it)
+  }
+
+  // From now on, our session leaves us alone (e.g., a "StopRTSPClientSession()" - from one of the callbacks below - doesn't
+  // shut us down again), and may be started again:
+  RTSPClientSessionData* sessionData = ((ourRTSPClient *)rtspClient)->m_pSessionData;
+  if (sessionData->rtspClient() == rtspClient) sessionData->setRTSPClient(NULL);
+
+  if (((ourRTSPClient *)rtspClient)->m_pFrameBatcher != NULL) {
+    ((ourRTSPClient *)rtspClient)->m_pFrameBatcher->flush(); // so that every frame is delivered before the close
+  }
+
   RTSPClient_CallBack* pRTSPClientCallBack = NULL;
   pRTSPClientCallBack = ((ourRTSPClient *)rtspClient)->m_pRTSPClientCallBack;
   if(NULL != pRTSPClientCallBack) {
        (*pRTSPClientCallBack)(RTSPC_CALLBACK_TYPE_SESSION_CLOSE, NULL, NULL, ((ourRTSPClient *)rtspClient)->m_pvPri);
   }
-  env << *rtspClient << "Closing the stream.\n";
+  STREAM_LOG(RTSPC_LOG_LEVEL_INFO, rtspClient, "Closing the stream.");
   Medium::close(rtspClient);
     // Note that this will also cause this stream's "StreamClientState" structure to get reclaimed.
-  env << "chenwenmin pid" << getpid() << " "  << __func__ << ":"<< __LINE__ << " rtspClientCount=" << rtspClientCount << ".\n";
-  if (--rtspClientCount == 0) {
-    // The final stream has ended, so exit the application now.
-    // (Of course, if you're embedding this code into your own application, you might want to comment this out,
-    // and replace it with "eventLoopWatchVariable = 1;", so that we leave the LIVE555 event loop, and continue running "main()".)
-    env << "chenwenmin pid" << getpid() << " "  << __func__ << ":"<< __LINE__ << " rtspClientCount=" << rtspClientCount << ".\n";
-  }
+  --rtspClientCount;
 }
 
 
 // Implementation of "ourRTSPClient":
 
 ourRTSPClient* ourRTSPClient::createNew(UsageEnvironment& env, char const* rtspURL,
-                    int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum) {
-  return new ourRTSPClient(env, rtspURL, verbosityLevel, applicationName, tunnelOverHTTPPortNum);
+                    int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum,
+                    RTSPClientSessionData* sessionData) {
+  return new ourRTSPClient(env, rtspURL, verbosityLevel, applicationName, tunnelOverHTTPPortNum, sessionData);
 }
 
 ourRTSPClient::ourRTSPClient(UsageEnvironment& env, char const* rtspURL,
-                 int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum)
-  : RTSPClient(env,rtspURL, verbosityLevel, applicationName, tunnelOverHTTPPortNum, -1) {
+                 int verbosityLevel, char const* applicationName, portNumBits tunnelOverHTTPPortNum,
+                 RTSPClientSessionData* sessionData)
+  : RTSPClient(env,rtspURL, verbosityLevel, applicationName, tunnelOverHTTPPortNum, -1),
+    m_pRTSPClientCallBack(NULL), m_pvPri(NULL),
+    m_iTransport(RTSPC_TRANSPORT_UDP), m_uiAutoTimeoutMs(3000), m_uiAutoLossPercent(10), m_bMulticast(False),
+    m_uiRecvBufferBytes(0), m_uiReorderThresholdMs(100), m_uiJitterBufferMinMs(0), m_uiJitterBufferMaxMs(0), m_bLowLatency(False),
+    m_pcTLSServerName(NULL), m_pcTLSCAFile(NULL), m_pFrameQueue(NULL), m_pFrameBatcher(NULL), m_uiMaxLatencyMs(0),
+    m_uiDropToKeyframeRequests(0), m_bSlowDown(False), m_stopTask(NULL), m_uiReconnects(0), m_uiSessionId(++lastSessionId),
+    m_pSessionData(sessionData != NULL ? sessionData : new RTSPClientSessionData), fOwnsSessionData(sessionData == NULL) {
+  fOrigURL = strDup(rtspURL);
+  m_pSessionData->setRTSPClient(this);
+  m_pSessionData->publishStreamStats(NULL, 0); // (not those of the session's previous client)
+  m_pSessionData->resetLatency(); // ditto
+  m_aLatency = m_pSessionData->latency();
+  m_pLoopUsage = &m_pSessionData->loopUsage();
+  m_pLoopUsage->reset(this); // ditto
+  m_pTimeline = &m_pSessionData->timeline(); // (reset by "RTSPClientSession::StartInLoop()", as the session starts)
+  m_pSessionData->setSessionId(m_uiSessionId);
 }
 
 ourRTSPClient::~ourRTSPClient() {
+  envir().taskScheduler().unscheduleDelayedTask(m_stopTask); // (if we're being shut down some other way first)
+  traceStartup(); // if we haven't already (e.g., because the startup failed, or the stream has no keyframes)
+  RTSPClientBatchReader::disableStream(socketNum()); // before "RTSPClient" closes the socket
+  if (m_pLoopUsage->owner() == this) { // (else our session has been started again, with a new client, that now owns it)
+    ((RTSPClientTaskScheduler&)envir().taskScheduler()).forgetOwner(m_pLoopUsage);
+    m_pLoopUsage->setOwner(NULL);
+  }
+  delete[] fOrigURL;
+  delete[] m_pcTLSServerName;
+  delete[] m_pcTLSCAFile;
+  delete m_pFrameBatcher;
+  if (m_pSessionData->rtspClient() == this) m_pSessionData->setRTSPClient(NULL); // (we weren't shut down by "shutdownStream()")
+  if (fOwnsSessionData) delete m_pSessionData;
+}
+
+int ourRTSPClient::connectToServer(int socketNum, portNumBits remotePortNum) {
+  m_pTimeline->end(RTSPC_PHASE_DNS); // (the server's address has been looked up, and the socket opened)
+  m_pTimeline->begin(RTSPC_PHASE_CONNECT);
+  setSocketOwner(envir(), socketNum, this, RTSPClientTaskScheduler::RTSP_HANDLER);
+  if (m_pcTLSServerName == NULL) return RTSPClient::connectToServer(socketNum, remotePortNum);
+
+  if (fVerbosityLevel >= 1) {
+    STREAM_LOG(RTSPC_LOG_LEVEL_INFO, this, "Opening TLS connection to %s, port %u...", m_pcTLSServerName, (unsigned)remotePortNum);
+  }
+  int result = RTSPClient::connectToServer(socketNum, remotePortNum);
+  if (result < 0) return result;
+
+  // Then talk (in plain RTSP) to a TLS relay that takes over the connection:
+  if (RTSPClientTLSConnection::createNew(envir(), socketNum, result > 0, remotePortNum, m_pcTLSServerName, m_pcTLSCAFile) == NULL) {
+    return -1;
+  }
+  return result;
+}
+
+Boolean ourRTSPClient::setRequestFields(RequestRecord* request,
+                                        char*& cmdURL, Boolean& cmdURLWasAllocated,
+                                        char const*& protocolStr,
+                                        char*& extraHeaders, Boolean& extraHeadersWereAllocated) {
+  if (!RTSPClient::setRequestFields(request, cmdURL, cmdURLWasAllocated, protocolStr, extraHeaders, extraHeadersWereAllocated)) {
+    return False;
+  }
+
+  // A request is sent only once we're connected (so the first one ends RTSPC_PHASE_CONNECT), and right after this:
+  m_pTimeline->end(RTSPC_PHASE_CONNECT);
+  if (strcmp(request->commandName(), "DESCRIBE") == 0) {
+    m_pTimeline->begin(RTSPC_PHASE_DESCRIBE);
+  } else if (strcmp(request->commandName(), "SETUP") == 0) {
+    m_pTimeline->beginSetup();
+  } else if (strcmp(request->commandName(), "PLAY") == 0) {
+    m_pTimeline->begin(RTSPC_PHASE_PLAY);
+  }
+
+  // If the SDP offered "a=rtcp-mux" (so that we've set up just one socket, for both RTP and RTCP), then ask for it (RFC 5761)
+  // in the "SETUP"'s "Transport:" header.  (live555 already sends "client_port=<N>-<N>" in this case.)
+  MediaSubsession* subsession = request->subsession();
+  if (strcmp(request->commandName(), "SETUP") == 0 && subsession != NULL && subsession->rtcpIsMuxed()
+      && !scs.streamUsingTCP) {
+    char const* transport = extraHeaders == NULL ? NULL : strstr(extraHeaders, "Transport: ");
+    char const* transportEnd = transport == NULL ? NULL : strstr(transport, "\r\n");
+    if (transportEnd != NULL) {
+      char const* const rtcpMuxStr = ";rtcp-mux";
+      unsigned newSize = strlen(extraHeaders) + strlen(rtcpMuxStr) + 1;
+      char* newExtraHeaders = new char[newSize];
+      snprintf(newExtraHeaders, newSize, "%.*s%s%s",
+               (int)(transportEnd - extraHeaders), extraHeaders, rtcpMuxStr, transportEnd);
+      if (extraHeadersWereAllocated) delete[] extraHeaders;
+      extraHeaders = newExtraHeaders;
+      extraHeadersWereAllocated = True;
+    }
+  }
+
+  return True;
+}
+
+void ourRTSPClient::resetConnection() {
+  RTSPClientBatchReader::disableStream(socketNum());
+  setSocketOwner(envir(), socketNum(), NULL, RTSPClientTaskScheduler::RTSP_HANDLER);
+  reset(); // note: this also forgets our URL
+  setBaseURL(fOrigURL);
 }
 
 
 // Implementation of "StreamClientState":
 
 StreamClientState::StreamClientState()
-  : iter(NULL), session(NULL), subsession(NULL), streamTimerTask(NULL), duration(0.0) {
+  : iter(NULL), session(NULL), subsession(NULL), streamTimerTask(NULL), duration(0.0),
+    streamUsingTCP(False), transportCheckTask(NULL), numPacketsExpected(0), numPacketsReceived(0), numLossyChecks(0),
+    streamStatsTask(NULL), jitterBufferTask(NULL), numPoolPortNums(0) {
 }
 
 StreamClientState::~StreamClientState() {
-  delete iter;
+  reset();
+}
+
+void StreamClientState::reset() {
+  delete iter; iter = NULL;
   if (session != NULL) {
-    // We also need to delete "session", and unschedule "streamTimerTask" (if set)
+    // We also need to delete "session", and unschedule "streamTimerTask", "transportCheckTask", "streamStatsTask" and
+    // "jitterBufferTask" (if set)
     UsageEnvironment& env = session->envir(); // alias
 
     env.taskScheduler().unscheduleDelayedTask(streamTimerTask);
-    Medium::close(session);
+    env.taskScheduler().unscheduleDelayedTask(transportCheckTask);
+    env.taskScheduler().unscheduleDelayedTask(streamStatsTask);
+    env.taskScheduler().unscheduleDelayedTask(jitterBufferTask);
+
+    // Stop batching the RTP sockets' reads (and attributing them to the session), before the sockets get closed:
+    MediaSubsessionIterator subsessionIter(*session);
+    MediaSubsession* sub;
+    while ((sub = subsessionIter.next()) != NULL) {
+      if (sub->rtpSource() != NULL) {
+        RTSPClientBatchReader::disable(sub->rtpSource()->RTPgs()->socketNum());
+        setSocketOwner(env, sub->rtpSource()->RTPgs()->socketNum(), NULL, RTSPClientTaskScheduler::RTSP_HANDLER);
+      }
+      if (sub->rtcpInstance() != NULL) {
+        setSocketOwner(env, sub->rtcpInstance()->RTCPgs()->socketNum(), NULL, RTSPClientTaskScheduler::RTSP_HANDLER);
+      }
+    }
+    Medium::close(session); session = NULL;
   }
+  for (unsigned i = 0; i < numPoolPortNums; ++i) RTSPClientPortPool::release(poolPortNums[i]);
+  numPoolPortNums = 0;
+  subsession = NULL;
+  duration = 0.0;
 }
 
 
 // Implementation of "DummySink":
 
+// What a H.264 or H.265 frame (i.e., NAL unit) is, as far as backpressure is concerned:
+enum FrameKind { FRAME_OTHER, FRAME_KEYFRAME, FRAME_PARAMETER_SET, FRAME_DISPOSABLE/*no other frame depends on it*/ };
+
+static FrameKind frameKind(int videoCodec, u_int8_t const* nal, unsigned nalSize) {
+  if (nalSize == 0) return FRAME_OTHER;
+
+  if (videoCodec == VIDEO_CODEC_H264) {
+    u_int8_t nalUnitType = nal[0]&0x1F;
+    if (nalUnitType == 5) return FRAME_KEYFRAME; // IDR slice
+    if (nalUnitType == 7 || nalUnitType == 8) return FRAME_PARAMETER_SET; // SPS, PPS
+    if (nalUnitType == 1 && (nal[0]&0x60) == 0) return FRAME_DISPOSABLE; // non-IDR slice, with nal_ref_idc == 0
+  } else if (videoCodec == VIDEO_CODEC_H265) {
+    u_int8_t nalUnitType = (nal[0]&0x7E)>>1;
+    if (nalUnitType >= 16 && nalUnitType <= 21) return FRAME_KEYFRAME; // IRAP (BLA, IDR, CRA)
+    if (nalUnitType >= 32 && nalUnitType <= 34) return FRAME_PARAMETER_SET; // VPS, SPS, PPS
+    if (nalUnitType <= 14 && (nalUnitType&1) == 0) return FRAME_DISPOSABLE; // sub-layer non-reference picture
+  }
+  return FRAME_OTHER;
+}
+
 // Even though we're not going to be doing anything with the incoming data, we still need to receive it.
 // Define the size of the buffer that we'll use:
 #define DUMMY_SINK_RECEIVE_BUFFER_SIZE 100000
 
-DummySink* DummySink::createNew(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId) {
-  return new DummySink(env, subsession, streamId);
+DummySink* DummySink::createNew(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId, Boolean streamUsingTCP) {
+  return new DummySink(env, subsession, streamId, streamUsingTCP);
 }
 
-DummySink::DummySink(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId)
+DummySink::DummySink(UsageEnvironment& env, MediaSubsession& subsession, char const* streamId, Boolean streamUsingTCP)
   : MediaSink(env),
-    fSubsession(subsession) {
+    m_pRTSPClientCallBack(NULL), m_pvPri(NULL), m_pFrameQueue(NULL), m_pFrameBatcher(NULL), m_iStreamIndex(0),
+    m_pRTSPClient(NULL), fSubsession(subsession), fDroppingToKeyframe(False), fDropToKeyframeRequestsSeen(0), fFramesSkipped(0),
+    fFramesReceived(0), fFramesTruncated(0), fBytesTruncated(0), fBytesReceived(0), fCallbackUsecs(0), fCallbacks(0), fCallbackMaxUsecs(0),
+    fLastStatsUsecs(RTSPClientLatencyHistogram::nowUsecs()), fLastStatsFrames(0), fLastStatsBytes(0) {
   fStreamId = strDup(streamId);
   fReceiveBuffer = new u_int8_t[DUMMY_SINK_RECEIVE_BUFFER_SIZE];
+  fVideoCodec = strcmp(subsession.codecName(), "H264") == 0 ? VIDEO_CODEC_H264
+    : strcmp(subsession.codecName(), "H265") == 0 ? VIDEO_CODEC_H265 : VIDEO_CODEC_OTHER;
+
+  // If the subsession uses SRTP (over UDP), then decrypt its incoming RTP packets with our own (EVP-based) context,
+  // rather than with live555's.  (Over TCP, only live555 sees whole packets; see "rtspclient_srtp.h".)
+  fSRTPContext = NULL;
+  if (subsession.getCrypto() != NULL && subsession.getMIKEYState() != NULL && subsession.rtpSource() != NULL && !streamUsingTCP) {
+    fSRTPContext = RTSPClientSRTPContext::createNew(env, *subsession.getMIKEYState());
+    if (fSRTPContext != NULL) RTSPClientSRTPContext::installOn(subsession.rtpSource(), fSRTPContext);
+  }
 }
 
 DummySink::~DummySink() {
+  if (fSRTPContext != NULL) {
+    RTSPClientSRTPContext::installOn(fSubsession.rtpSource(), NULL);
+    delete fSRTPContext;
+  }
   delete[] fReceiveBuffer;
   delete[] fStreamId;
 }
 
-#include <stdio.h>
-
-void DummySink::printfHex(u_int8_t* data, int len)
-{
-#if 1
-    int i = 0;
-
-    for(i = 0; i < len; i++) {
-        if(0 == (i % 8)) {
-            envir() << "\n";
-        }
-        envir() << data[i] << ",";
-    }
-    envir() << "\n";
-#else
-
-    int i = 0;
-
-    for(i = 0; i < len; i++) {
-        if(0 == (i % 8)) {
-            printf("\n");
-        }
-        printf("0x%2x, ", data[i]);
-    }
-    printf("\n");
-#endif
-}
 void DummySink::afterGettingFrame(void* clientData, unsigned frameSize, unsigned numTruncatedBytes,
                   struct timeval presentationTime, unsigned durationInMicroseconds) {
   DummySink* sink = (DummySink*)clientData;
   sink->afterGettingFrame(frameSize, numTruncatedBytes, presentationTime, durationInMicroseconds);
 }
 
-// If you don't want to see debugging output for each received frame, then comment out the following line:
-#define DEBUG_PRINT_EACH_RECEIVED_FRAME 1
-
 void DummySink::afterGettingFrame(unsigned frameSize, unsigned numTruncatedBytes,
                   struct timeval presentationTime, unsigned /*durationInMicroseconds*/) {
-  // We've just received a frame of data.  (Optionally) print out information about it:
-#ifdef DEBUG_PRINT_EACH_RECEIVED_FRAME
-  if (fStreamId != NULL) envir() << "chenwenmin " << "pid " << getpid() << " " << "Stream \"" << fStreamId << "\"; ";
-  envir() << fSubsession.mediumName() << "/" << fSubsession.codecName() << ":\tReceived " << frameSize << " bytes";
-  if (numTruncatedBytes > 0) envir() << " (with " << numTruncatedBytes << " bytes truncated)";
-  char uSecsStr[6+1]; // used to output the 'microseconds' part of the presentation time
-  sprintf(uSecsStr, "%06u", (unsigned)presentationTime.tv_usec);
-  envir() << ".\tPresentation time: " << (int)presentationTime.tv_sec << "." << uSecsStr;
-  if (fSubsession.rtpSource() != NULL && !fSubsession.rtpSource()->hasBeenSynchronizedUsingRTCP()) {
-    envir() << "!"; // mark the debugging output to indicate that this presentation time is not RTCP-synchronized
-  }
-#ifdef DEBUG_PRINT_NPT
-  envir() << "\tNPT: " << fSubsession.getNormalPlayTime(presentationTime);
-#endif
-  envir() << "\n";
-#endif
-    if(NULL != m_pRTSPClientCallBack) {
-        envir() << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
+  // We've just received a frame of data.  (Optionally) log information about it.  (This is compiled out unless
+  // RTSPCLIENT_LOG_MAX_LEVEL is RTSPC_LOG_LEVEL_TRACE - see "rtspclient_log.h".)
+  RTSPC_LOG(RTSPC_LOG_LEVEL_TRACE, NULL, "Stream \"%s\"; %s/%s:\tReceived %u bytes (%u truncated).\tPresentation time: %d.%06u%s",
+            fStreamId != NULL ? fStreamId : "", fSubsession.mediumName(), fSubsession.codecName(), frameSize, numTruncatedBytes,
+            (int)presentationTime.tv_sec, (unsigned)presentationTime.tv_usec,
+            fSubsession.rtpSource() != NULL && !fSubsession.rtpSource()->hasBeenSynchronizedUsingRTCP() ? "!" : "");
+  if (m_pRTSPClient != NULL && m_pRTSPClient->m_stopTask != NULL) return; // we've been stopped (and are about to be closed)
+  // Timestamp the frame, for the latency histograms (see "rtspclient_latency.h"):
+  u_int64_t ullFrameUs = RTSPClientLatencyHistogram::nowUsecs();
+  u_int64_t ullArrivalUs = 0;
+  if (m_pRTSPClient != NULL) {
+    int iSocket = m_pRTSPClient->scs.streamUsingTCP ? m_pRTSPClient->socketNum()
+      : fSubsession.rtpSource() != NULL ? fSubsession.rtpSource()->RTPgs()->socketNum() : -1;
+    ullArrivalUs = RTSPClientBatchReader::arrivalUsecs(iSocket);
+    m_pRTSPClient->m_aLatency[RTSPC_LATENCY_ARRIVAL_TO_FRAME].recordInterval(ullArrivalUs, ullFrameUs);
+    if (!m_pRTSPClient->m_pTimeline->hasEnded(RTSPC_PHASE_FIRST_RTP)) {
+      m_pRTSPClient->m_pTimeline->end(RTSPC_PHASE_FIRST_RTP, ullArrivalUs != 0 ? ullArrivalUs : ullFrameUs);
+    }
+  }
+  RTSPCLIENT_PROBE6(frame, NULL != m_pRTSPClient ? m_pRTSPClient->m_uiSessionId : 0, m_iStreamIndex, frameSize, numTruncatedBytes,
+                    ullArrivalUs, ullFrameUs);
+
+  ++fFramesReceived;
+  fBytesReceived += frameSize;
+  if (numTruncatedBytes > 0) {
+    ++fFramesTruncated;
+    fBytesTruncated += numTruncatedBytes;
+  }
+
+    // Backpressure: discard the frame here - before it's copied anywhere - if our consumer has asked us to:
+    FrameKind eFrameKind = frameKind(fVideoCodec, fReceiveBuffer + 4, frameSize);
+    if(FRAME_KEYFRAME == eFrameKind && NULL != m_pRTSPClient && !m_pRTSPClient->m_pTimeline->hasEnded(RTSPC_PHASE_FIRST_KEYFRAME)) {
+        m_pRTSPClient->m_pTimeline->end(RTSPC_PHASE_FIRST_KEYFRAME, ullFrameUs);
+        if(m_pRTSPClient->m_pTimeline->hasEnded(RTSPC_PHASE_FIRST_CALLBACK)) {
+            m_pRTSPClient->traceStartup();
+        }
+    }
+    if(VIDEO_CODEC_OTHER != fVideoCodec && NULL != m_pRTSPClient) {
+        if(m_pRTSPClient->m_uiDropToKeyframeRequests != fDropToKeyframeRequestsSeen) {
+            fDropToKeyframeRequestsSeen = m_pRTSPClient->m_uiDropToKeyframeRequests;
+            fDroppingToKeyframe = True;
+        }
+        if(fDroppingToKeyframe && FRAME_KEYFRAME == eFrameKind) {
+            fDroppingToKeyframe = False;
+        }
+        if((fDroppingToKeyframe && FRAME_PARAMETER_SET != eFrameKind)
+           || (m_pRTSPClient->m_bSlowDown && FRAME_DISPOSABLE == eFrameKind)) {
+            ++fFramesSkipped;
+            continuePlaying();
+            return;
+        }
+    }
+
+    if(NULL != m_pRTSPClient && !m_pRTSPClient->m_pTimeline->hasEnded(RTSPC_PHASE_FIRST_CALLBACK)) {
+        // (The frame is handed over at once, so this is when:)
+        m_pRTSPClient->m_pTimeline->end(RTSPC_PHASE_FIRST_CALLBACK, ullFrameUs);
+        if(m_pRTSPClient->m_pTimeline->hasEnded(RTSPC_PHASE_FIRST_KEYFRAME)) {
+            m_pRTSPClient->traceStartup();
+        }
+    }
+
+    RTSPClientAttr stRTSPClientAttr;
+    fReceiveBuffer[0] = 0x00;
+    fReceiveBuffer[1] = 0x00;
+    fReceiveBuffer[2] = 0x00;
+    fReceiveBuffer[3] = 0x01;
+    stRTSPClientAttr.m_uiDataLen = 4 + frameSize;
+    stRTSPClientAttr.m_uiTimestamp = fSubsession.getNormalPlayTime(presentationTime) * 1000;
+    stRTSPClientAttr.m_iWidth = 0;
+    stRTSPClientAttr.m_iHigh = 0;
+
+    ++frameDeliveryDepth;
+    if(NULL != m_pFrameQueue) {
+        unsigned int uiMaxAgeUs = NULL != m_pRTSPClient ? m_pRTSPClient->m_uiMaxLatencyMs * 1000 : 0;
+        if(RTSPClientFrameQueue::BEHIND == m_pFrameQueue->push(stRTSPClientAttr, m_iStreamIndex, fReceiveBuffer, uiMaxAgeUs)) {
+            // The consumer is too far behind; its queued frames have been dropped.  Restart from a keyframe:
+            handleBackpressure(RTSPC_CALLBACK_RET_DROP_TO_IDR);
+            if(VIDEO_CODEC_OTHER == fVideoCodec || FRAME_KEYFRAME == eFrameKind || FRAME_PARAMETER_SET == eFrameKind) {
+                // (This frame doesn't depend on those dropped, so can still be queued)
+                if(NULL != m_pRTSPClient) {
+                    fDropToKeyframeRequestsSeen = m_pRTSPClient->m_uiDropToKeyframeRequests;
+                }
+                fDroppingToKeyframe = False;
+                m_pFrameQueue->push(stRTSPClientAttr, m_iStreamIndex, fReceiveBuffer);
+            } else {
+                ++fFramesSkipped;
+            }
+        }
+    } else if(NULL != m_pFrameBatcher) {
+        // A video frame whose (last) RTP packet has the marker bit set completes an access unit:
+        Boolean bEndsAccessUnit = strcmp(fSubsession.mediumName(), "video") == 0 && fSubsession.rtpSource() != NULL
+          && fSubsession.rtpSource()->curPacketMarkerBit();
+        int iResult = m_pFrameBatcher->add(stRTSPClientAttr, m_iStreamIndex, fReceiveBuffer, bEndsAccessUnit, ullArrivalUs, ullFrameUs);
+        countCallback(RTSPClientLatencyHistogram::nowUsecs() - ullFrameUs);
+        handleBackpressure(iResult);
+    } else if(NULL != m_pRTSPClientCallBack) {
         //(int _iType, RTSPClientAttr *_pstRTSPClientAttr, unsigned char *_pucData, void *_pvPri);
-        RTSPClientAttr stRTSPClientAttr;
-        envir() << "chenwenmin pid " << (int *)m_pRTSPClientCallBack << " "<< __func__ << ":" <<__LINE__ << "\n";
-        fReceiveBuffer[0] = 0x00;
-        fReceiveBuffer[1] = 0x00;
-        fReceiveBuffer[2] = 0x00;
-        fReceiveBuffer[3] = 0x01;
-        stRTSPClientAttr.m_uiDataLen = 4 + frameSize;
-        stRTSPClientAttr.m_uiTimestamp = fSubsession.getNormalPlayTime(presentationTime) * 1000;
-        (*m_pRTSPClientCallBack)(RTSPC_CALLBACK_TYPE_MEDIA_DATA, &stRTSPClientAttr, fReceiveBuffer, m_pvPri);
-    }
-    printfHex(fReceiveBuffer, (frameSize > 32) ? 32 : frameSize);
+        // (The callback is entered at once, so "ullFrameUs" serves as its entry time:)
+        int iResult = (*m_pRTSPClientCallBack)(RTSPC_CALLBACK_TYPE_MEDIA_DATA, &stRTSPClientAttr, fReceiveBuffer, m_pvPri);
+        u_int64_t ullReturnUs = RTSPClientLatencyHistogram::nowUsecs();
+        countCallback(ullReturnUs - ullFrameUs);
+        if(NULL != m_pRTSPClient) {
+            m_pRTSPClient->m_aLatency[RTSPC_LATENCY_CALLBACK].record(ullReturnUs - ullFrameUs);
+            m_pRTSPClient->m_aLatency[RTSPC_LATENCY_ARRIVAL_TO_RETURN].recordInterval(ullArrivalUs, ullReturnUs);
+        }
+        handleBackpressure(iResult);
+    }
+    --frameDeliveryDepth;
+    RTSPCLIENT_PROBE5(frame_done, NULL != m_pRTSPClient ? m_pRTSPClient->m_uiSessionId : 0, m_iStreamIndex, ullArrivalUs, ullFrameUs,
+                      RTSPClientLatencyHistogram::nowUsecs());
   // Then continue, to request the next frame of data:
-    envir() << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
   continuePlaying();
 }
 
 
+void DummySink::takeStats(RTSPClientStreamStats& stats) {
+  u_int64_t nowUsecs = RTSPClientLatencyHistogram::nowUsecs();
+  u_int64_t intervalUsecs = nowUsecs - fLastStatsUsecs;
+
+  stats.m_uiFramesSkipped = fFramesSkipped;
+  stats.m_uiFramesReceived = fFramesReceived;
+  stats.m_ullBytesReceived = fBytesReceived;
+  if (intervalUsecs >= STREAM_STATS_INTERVAL_MSECS*1000/2) { // (a shorter interval - right after the start - gives a meaningless rate)
+    stats.m_uiFramesPerSecond = (unsigned)(((u_int64_t)(fFramesReceived - fLastStatsFrames)*1000000 + intervalUsecs/2)/intervalUsecs);
+    stats.m_uiBytesPerSecond = (unsigned)(((fBytesReceived - fLastStatsBytes)*1000000 + intervalUsecs/2)/intervalUsecs);
+  }
+  stats.m_uiFramesTruncated = fFramesTruncated;
+  stats.m_uiBytesTruncated = fBytesTruncated;
+  stats.m_uiCallbackAvgUs = fCallbacks > 0 ? (unsigned)(fCallbackUsecs/fCallbacks) : 0;
+  stats.m_uiCallbackMaxUs = fCallbackMaxUsecs;
+  stats.m_uiSRTPPacketsDropped = fSRTPContext != NULL ? fSRTPContext->numPacketsDropped() : 0;
+
+  fLastStatsUsecs = nowUsecs;
+  fLastStatsFrames = fFramesReceived;
+  fLastStatsBytes = fBytesReceived;
+  fCallbackUsecs = 0;
+  fCallbacks = fCallbackMaxUsecs = 0;
+}
+
+void DummySink::handleBackpressure(int result) {
+  if (m_pRTSPClient == NULL) return;
+
+  switch (result) {
+    case RTSPC_CALLBACK_RET_SLOW_DOWN: {
+      m_pRTSPClient->m_bSlowDown = True;
+      break;
+    }
+    case RTSPC_CALLBACK_RET_DROP_TO_IDR: {
+      ++m_pRTSPClient->m_uiDropToKeyframeRequests; // each video sink sees this when it gets its next frame
+      break;
+    }
+    default: { // RTSPC_CALLBACK_RET_OK
+      m_pRTSPClient->m_bSlowDown = False;
+      break;
+    }
+  }
+}
+
 Boolean DummySink::continuePlaying() {
   if (fSource == NULL) return False; // sanity check (should not happen)
 
-  envir() << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
 
   // Request the next frame of data from our input source.  "afterGettingFrame()" will get called later, when it arrives:
   fSource->getNextFrame(fReceiveBuffer + 4, DUMMY_SINK_RECEIVE_BUFFER_SIZE - 4,
@@ -611,12 +1515,138 @@ Boolean DummySink::continuePlaying() {
 }
 
 
-TaskScheduler* RTSPClientSession::m_pscheduler = NULL;
-UsageEnvironment* RTSPClientSession::m_penv = NULL;
+RTSPClientInfo::RTSPClientInfo()
+{
+    m_cRTSPUrl[0] = '\0';
+    m_pRTSPClientCallBack = NULL;
+    m_pvPri = NULL;
+    m_iTransport = RTSPC_TRANSPORT_UDP;
+    m_usHTTPTunnelPort = 80;
+    m_uiAutoTimeoutMs = 3000;
+    m_uiAutoLossPercent = 10;
+    m_bMulticast = false;
+    m_uiRecvBufferBytes = 0;
+    m_uiReorderThresholdMs = 100;
+    m_uiJitterBufferMinMs = 0;
+    m_uiJitterBufferMaxMs = 0;
+    m_bLowLatency = false;
+    m_cTLSCAFile[0] = '\0';
+    m_uiFrameQueueFrames = 0;
+    m_iFrameQueuePolicy = RTSPC_FRAMEQUEUE_DROP_OLDEST;
+    m_uiMaxLatencyMs = 0;
+    m_pRTSPClientBatchCallBack = NULL;
+    m_uiBatchFrames = 16;
+    m_uiBatchDelayUs = 5000;
+    m_iVerbosity = RTSPC_VERBOSITY_NONE;
+    m_uiVerbositySampling = 1;
+
+    return;
+}
+
+RTSPClientFrame::RTSPClientFrame()
+{
+    memset(&m_stAttr, 0, sizeof(m_stAttr));
+    m_iStream = 0;
+    m_pucData = NULL;
+    m_pvBuffer = NULL;
+
+    return;
+}
+
+RTSPClientInitInfo::RTSPClientInitInfo()
+{
+    m_bEventFdWakeUp = false;
+    m_bIOUring = false;
+    m_cCPUList[0] = '\0';
+    m_iSchedPolicy = SCHED_OTHER;
+    m_iSchedPriority = 0;
+    m_iNUMANode = -1;
+    m_bExternalLoop = false;
+    m_bLoopProfiling = false;
+    m_uiStallThresholdMs = 0;
+
+    return;
+}
+
+TaskScheduler* RTSPClientSession::m_pscheduler = NULL;
+UsageEnvironment* RTSPClientSession::m_penv = NULL;
+
+// Requests (from other threads) to run a function in the event loop thread - which is the only thread that may call live555:
+struct RTSPClientLoopRequest {
+    void (*m_pFunc)(void *);
+    void *m_pvArg;
+    bool m_bDone;
+    RTSPClientLoopRequest *m_pNext;
+};
+
+static pthread_mutex_t s_loopRequestMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_loopRequestCond = PTHREAD_COND_INITIALIZER;
+static RTSPClientLoopRequest *s_pLoopRequestHead = NULL;
+static RTSPClientLoopRequest *s_pLoopRequestTail = NULL;
+static EventTriggerId s_loopRequestTrigger = 0;
+static pthread_t s_loopThread;//the thread that runs the event loop (ours, or the application's with m_bExternalLoop)
+static bool s_bExternalLoop = false;
+static char s_loopWatchVariable = 0;//makes our event loop thread return, for RTSPClientSessionDeinit
+
+static void loopRequestHandler(void *)
+{
+    pthread_mutex_lock(&s_loopRequestMutex);
+    RTSPClientLoopRequest *pRequests = s_pLoopRequestHead;
+    s_pLoopRequestHead = s_pLoopRequestTail = NULL;
+    pthread_mutex_unlock(&s_loopRequestMutex);
+
+    while(NULL != pRequests) {
+        RTSPClientLoopRequest *pNext = pRequests->m_pNext; // "pRequests" may go away once it's done
+        pRequests->m_pFunc(pRequests->m_pvArg);
+
+        pthread_mutex_lock(&s_loopRequestMutex);
+        pRequests->m_bDone = true;
+        pthread_cond_broadcast(&s_loopRequestCond);
+        pthread_mutex_unlock(&s_loopRequestMutex);
+        pRequests = pNext;
+    }
+
+    return;
+}
+
+static void runInLoopThread(void (*_pFunc)(void *), void *_pvArg)
+{
+    if(0 == s_loopRequestTrigger || pthread_equal(pthread_self(), s_loopThread)) {
+        _pFunc(_pvArg);
+        return;
+    }
+
+    RTSPClientLoopRequest stRequest;
+    stRequest.m_pFunc = _pFunc;
+    stRequest.m_pvArg = _pvArg;
+    stRequest.m_bDone = false;
+    stRequest.m_pNext = NULL;
+
+    pthread_mutex_lock(&s_loopRequestMutex);
+    if(NULL == s_pLoopRequestTail) {
+        s_pLoopRequestHead = &stRequest;
+    } else {
+        s_pLoopRequestTail->m_pNext = &stRequest;
+    }
+    s_pLoopRequestTail = &stRequest;
+    pthread_mutex_unlock(&s_loopRequestMutex);
+
+    RTSPClientSession::m_pscheduler->triggerEvent(s_loopRequestTrigger, NULL);
+
+    pthread_mutex_lock(&s_loopRequestMutex);
+    while(!stRequest.m_bDone) {
+        pthread_cond_wait(&s_loopRequestCond, &s_loopRequestMutex);
+    }
+    pthread_mutex_unlock(&s_loopRequestMutex);
+
+    return;
+}
 
 RTSPClientSession::RTSPClientSession()
 {
-    m_pRTSPClient = NULL;
+    m_pData = new RTSPClientSessionData;
+    m_pFrameQueue = NULL;
+    m_uiStarts = 0;
     m_pucReceiveFrame = NULL;
     m_pvPri = this;
 
@@ -625,41 +1655,180 @@ RTSPClientSession::RTSPClientSession()
 
 RTSPClientSession::~RTSPClientSession()
 {
+    // The running client (if any) uses our frame queue and m_pData, so must be shut down first:
+    StopRTSPClientSession();
+
+    if(NULL != m_pFrameQueue) {
+        delete m_pFrameQueue;
+        m_pFrameQueue = NULL;
+    }
+    delete m_pData;
+    m_pData = NULL;
 
     return;
 }
 
-static void *RTSPClientThread(void *)
+static void *RTSPClientThread(void *_pvNUMANode)
 {
-    for(;;) {
-        UsageEnvironment* env = RTSPClientSession::m_penv;
-        // All subsequent activity takes place within the event loop:
-        *env << "chenwenmin  " << __NR_gettid << " "<< __func__ << ":" <<__LINE__ << "\n";
-        *env << "chenwenmin pid " << getpid() << " "  << "tid " << (int)syscall(__NR_gettid) << " "<< __func__ << ":" <<__LINE__ << "\n";
-        env->taskScheduler().doEventLoop(&eventLoopWatchVariable);
-        // This function call does not return, unless, at some point in time, "eventLoopWatchVariable" gets set to something non-zero.
+    int iNUMANode = (int)(long)_pvNUMANode;
+    if(iNUMANode >= 0) {
+        // Done before the thread allocates anything, so that all the session buffers come from this node:
+        RTSPClientThreadPlacement::preferNode(iNUMANode);
     }
 
+    UsageEnvironment* env = RTSPClientSession::m_penv;
+    // All subsequent activity takes place within the event loop:
+    env->taskScheduler().doEventLoop(&s_loopWatchVariable);
+    // This function call does not return, unless "s_loopWatchVariable" gets set (by RTSPClientSessionDeinit).
+
     return NULL;
 }
 
+static RTSPClientLogLimiter s_stallLogLimiter;
+
+static void loopStallHandler(void *, RTSPClientLoopUsage *_pOwner, RTSPClientTaskScheduler::HandlerType _eType, int _iSocket,
+                             u_int64_t _ullUsecs)
+{
+    static char const *const apcTypeNames[RTSPClientTaskScheduler::NUM_HANDLER_TYPES] = {"media", "RTSP", "timer", "trigger"};
+    char cSocket[32] = "";
+    if(_iSocket >= 0) {
+        snprintf(cSocket, sizeof(cSocket), " (socket %d)", _iSocket);
+    }
+
+    ourRTSPClient *pRTSPClient = NULL == _pOwner ? NULL : (ourRTSPClient *)_pOwner->owner();
+    if(NULL != pRTSPClient) {
+        STREAM_LOG(RTSPC_LOG_LEVEL_WARNING, pRTSPClient, "Stalled the event loop for %u ms, in a %s handler%s",
+                   (unsigned)(_ullUsecs / 1000), apcTypeNames[_eType], cSocket);
+    } else {
+        RTSPC_LOG(RTSPC_LOG_LEVEL_WARNING, &s_stallLogLimiter, "The event loop stalled for %u ms, in a %s handler%s of no session",
+                  (unsigned)(_ullUsecs / 1000), apcTypeNames[_eType], cSocket);
+    }
+
+    return;
+}
+
+static void EnableLoopProfiling(RTSPClientInitInfo *_pRTSPClientInitInfo)
+{
+    if(_pRTSPClientInitInfo->m_bLoopProfiling || _pRTSPClientInitInfo->m_uiStallThresholdMs > 0) {
+        ((RTSPClientTaskScheduler *)RTSPClientSession::m_pscheduler)->enableProfiling(_pRTSPClientInitInfo->m_uiStallThresholdMs * 1000,
+                                                                                      loopStallHandler, NULL);
+    }
+
+    return;
+}
+
+static void StopLoopInLoop(void *)
+{
+    s_loopWatchVariable = 1;
+
+    return;
+}
+
 int RTSPClientSession::RTSPClientSessionInit()
 {
+    RTSPClientInitInfo stRTSPClientInitInfo;
+
+    return RTSPClientSessionInit(&stRTSPClientInitInfo);
+}
+
+int RTSPClientSession::RTSPClientSessionInit(RTSPClientInitInfo *_pRTSPClientInitInfo)
+{
+    if(NULL == _pRTSPClientInitInfo) {
+        return -1;
+    }
+
     // Begin by setting up our usage environment:
-    if(NULL == RTSPClientSession::m_penv) {
-        RTSPClientSession::m_pscheduler = BasicTaskScheduler::createNew();
-        RTSPClientSession::m_penv = BasicUsageEnvironment::createNew(*(RTSPClientSession::m_pscheduler));
+    if(NULL == RTSPClientSession::m_penv && _pRTSPClientInitInfo->m_bExternalLoop) {
+        RTSPClientSession::m_pscheduler = RTSPClientTaskScheduler::createNew(10000, _pRTSPClientInitInfo->m_bEventFdWakeUp,
+                                                                             _pRTSPClientInitInfo->m_bIOUring);
+        RTSPClientSession::m_penv = RTSPClientUsageEnvironment::createNew(*(RTSPClientSession::m_pscheduler));
+        s_loopRequestTrigger = RTSPClientSession::m_pscheduler->createEventTrigger(loopRequestHandler);
+        EnableLoopProfiling(_pRTSPClientInitInfo);
+        s_loopThread = pthread_self();
+        s_bExternalLoop = true;
+    } else if(NULL == RTSPClientSession::m_penv) {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(!RTSPClientThreadPlacement::setAttributes(&attr, _pRTSPClientInitInfo->m_cCPUList, _pRTSPClientInitInfo->m_iNUMANode,
+                                                     _pRTSPClientInitInfo->m_iSchedPolicy, _pRTSPClientInitInfo->m_iSchedPriority)) {
+            pthread_attr_destroy(&attr);
+            return -1;
+        }
+
+        RTSPClientSession::m_pscheduler = RTSPClientTaskScheduler::createNew(10000, _pRTSPClientInitInfo->m_bEventFdWakeUp,
+                                                                             _pRTSPClientInitInfo->m_bIOUring);
+        RTSPClientSession::m_penv = RTSPClientUsageEnvironment::createNew(*(RTSPClientSession::m_pscheduler));
+        s_loopRequestTrigger = RTSPClientSession::m_pscheduler->createEventTrigger(loopRequestHandler);
+        EnableLoopProfiling(_pRTSPClientInitInfo);
 
         pthread_t new_th;
         int ret;
 
-        ret = pthread_create(&new_th, NULL, RTSPClientThread, NULL);
+        ret = pthread_create(&new_th, &attr, RTSPClientThread, (void *)(long)_pRTSPClientInitInfo->m_iNUMANode);
+        pthread_attr_destroy(&attr);
         if (ret != 0) {
+            // e.g., EPERM for a real-time policy without CAP_SYS_NICE; leave things as they were, so that Init can be retried:
+            RTSPClientSession::m_pscheduler->deleteEventTrigger(s_loopRequestTrigger);
+            s_loopRequestTrigger = 0;
+            RTSPClientSession::m_penv->reclaim();
+            RTSPClientSession::m_penv = NULL;
+            delete RTSPClientSession::m_pscheduler;
+            RTSPClientSession::m_pscheduler = NULL;
             return -1;
         }
-        pthread_detach(new_th);
+        s_loopThread = new_th;
+        s_bExternalLoop = false;
+    }
+
+    return 0;
+}
+
+int RTSPClientSession::RTSPClientSessionStep(int _iTimeoutMs)
+{
+    if(NULL == RTSPClientSession::m_penv || !s_bExternalLoop || !pthread_equal(pthread_self(), s_loopThread)) {
+        return -1;
+    }
+
+    unsigned uiMaxDelayUs = _iTimeoutMs < 0 ? 0/*no limit*/ : (_iTimeoutMs == 0 ? 1 : (unsigned)_iTimeoutMs * 1000);
+    ((RTSPClientTaskScheduler *)RTSPClientSession::m_pscheduler)->step(uiMaxDelayUs);
+
+    return 0;
+}
+
+int RTSPClientSession::RTSPClientSessionDeinit()
+{
+    if(NULL == RTSPClientSession::m_penv) {
+        return -1;
+    }
+
+    if(s_bExternalLoop && !pthread_equal(pthread_self(), s_loopThread)) {
+        return -1;//the application's loop thread may be in RTSPClientSessionStep
+    }
+
+    if(rtspClientCount > 0) {
+        return -1;
+    }
+
+    if(!s_bExternalLoop) {
+        if(pthread_equal(pthread_self(), s_loopThread)) {
+            return -1;//(called from a callback) our thread can't wait for itself
+        }
+        runInLoopThread(StopLoopInLoop, NULL);
+        pthread_join(s_loopThread, NULL);
+        s_loopWatchVariable = 0;
     }
 
+    RTSPClientSession::m_pscheduler->deleteEventTrigger(s_loopRequestTrigger);
+    s_loopRequestTrigger = 0;
+    RTSPClientSession::m_penv->reclaim();
+    RTSPClientSession::m_penv = NULL;
+    delete RTSPClientSession::m_pscheduler;
+    RTSPClientSession::m_pscheduler = NULL;
+    s_bExternalLoop = false;
+
+    RTSPClientLog::flush();
+    RTSPClientLog::stopWriter();
+
     return 0;
 }
 
@@ -685,25 +1854,365 @@ int RTSPClientSession::StartRTSPClientSession(RTSPClientInfo *_pRTSPClientInfo)
         return -1;
     }
 
-    if(NULL == _pRTSPClientInfo->m_pRTSPClientCallBack) {
+    if(NULL == _pRTSPClientInfo->m_pRTSPClientCallBack && NULL == _pRTSPClientInfo->m_pRTSPClientBatchCallBack
+       && 0 == _pRTSPClientInfo->m_uiFrameQueueFrames) {
         return -1;
     }
 
-    UsageEnvironment* env = RTSPClientSession::m_penv;
+    if(_pRTSPClientInfo->m_iTransport < RTSPC_TRANSPORT_UDP || _pRTSPClientInfo->m_iTransport > RTSPC_TRANSPORT_AUTO) {
+        return -1;
+    }
 
-    m_pRTSPClient = openURL(*env, "wenminchen@126.com", _pRTSPClientInfo->m_cRTSPUrl);
-    ((ourRTSPClient*)m_pRTSPClient)->m_pRTSPClientCallBack = _pRTSPClientInfo->m_pRTSPClientCallBack;
-    ((ourRTSPClient*)m_pRTSPClient)->m_pvPri = _pRTSPClientInfo->m_pvPri;
+    if(_pRTSPClientInfo->m_iFrameQueuePolicy != RTSPC_FRAMEQUEUE_DROP_OLDEST
+       && _pRTSPClientInfo->m_iFrameQueuePolicy != RTSPC_FRAMEQUEUE_DROP_NEWEST) {
+        return -1;
+    }
 
-    //StreamClientState& scs = ((ourRTSPClient*)m_pRTSPClient)->scs; // alias
+    if(_pRTSPClientInfo->m_iVerbosity < RTSPC_VERBOSITY_NONE || _pRTSPClientInfo->m_iVerbosity > RTSPC_VERBOSITY_PROTOCOL) {
+        return -1;
+    }
+
+    if(NULL != m_pData->rtspClient()) {
+        return -1;//still started (and using its queue)
+    }
+
+    if(_pRTSPClientInfo->m_uiFrameQueueFrames > 0) {
+        if(NULL != m_pFrameQueue && !m_pFrameQueue->hasParameters(_pRTSPClientInfo->m_uiFrameQueueFrames,
+                                                                 _pRTSPClientInfo->m_iFrameQueuePolicy)) {
+            delete m_pFrameQueue;
+            m_pFrameQueue = NULL;
+        }
+        if(NULL == m_pFrameQueue) {
+            m_pFrameQueue = new RTSPClientFrameQueue(_pRTSPClientInfo->m_uiFrameQueueFrames, _pRTSPClientInfo->m_iFrameQueuePolicy);
+        }
+    }
+
+    StartRequest stStartRequest;
+    stStartRequest.m_pRTSPClientInfo = _pRTSPClientInfo;
+    stStartRequest.m_pFrameQueue = _pRTSPClientInfo->m_uiFrameQueueFrames > 0 ? m_pFrameQueue : NULL;
+    stStartRequest.m_iVerbosity = RTSPC_VERBOSITY_NONE;
+    if(_pRTSPClientInfo->m_uiVerbositySampling <= 1 || 0 == m_uiStarts % _pRTSPClientInfo->m_uiVerbositySampling) {
+        stStartRequest.m_iVerbosity = _pRTSPClientInfo->m_iVerbosity;
+    }
+    stStartRequest.m_uiReconnects = m_uiStarts;
+    stStartRequest.m_ullStartUs = RTSPClientLatencyHistogram::nowUsecs();
+    m_uiStarts++;
+    stStartRequest.m_pData = m_pData;
+    stStartRequest.m_pRTSPClient = NULL;
+    runInLoopThread(StartInLoop, &stStartRequest);
+
+    if(NULL == stStartRequest.m_pRTSPClient) {
+        if(NULL != stStartRequest.m_pFrameQueue && NULL == m_pData->rtspClient()) {
+            stStartRequest.m_pFrameQueue->close();
+        }
+        return -1;
+    }
 
     return 0;
 }
 
+void RTSPClientSession::StartInLoop(void *_pvStartRequest)
+{
+    StartRequest *pStartRequest = (StartRequest *)_pvStartRequest;
+    UsageEnvironment* env = RTSPClientSession::m_penv;
+
+    if(NULL != pStartRequest->m_pData->rtspClient()) {
+        return;//still started
+    }
+
+    pStartRequest->m_pData->timeline().reset();
+    pStartRequest->m_pData->timeline().setStartUsecs(pStartRequest->m_ullStartUs);
+    RTSPClient *pRTSPClient = openURL(*env, "wenminchen@126.com", pStartRequest->m_pRTSPClientInfo->m_cRTSPUrl,
+                                      pStartRequest->m_pRTSPClientInfo, pStartRequest->m_iVerbosity, pStartRequest->m_pData);
+    // (If the "DESCRIBE" failed at once - e.g., the server's name couldn't be resolved - the client has already been closed:)
+    bool bStarted = NULL != pRTSPClient && pRTSPClient == pStartRequest->m_pData->rtspClient();
+    if(NULL != pStartRequest->m_pFrameQueue) {
+        // (Re)start the queue, empty, for the new client's frames (if it failed to start, "StartRTSPClientSession" closes it):
+        pStartRequest->m_pFrameQueue->open(bStarted ? ((ourRTSPClient *)pRTSPClient)->m_uiSessionId : 0);
+    }
+    if(bStarted) {
+        pStartRequest->m_pRTSPClient = pRTSPClient;
+        // Set before any frame can arrive (i.e., before "openURL()"'s "DESCRIBE" gets its response):
+        ((ourRTSPClient *)pStartRequest->m_pRTSPClient)->m_pFrameQueue = pStartRequest->m_pFrameQueue;
+        ((ourRTSPClient *)pStartRequest->m_pRTSPClient)->m_uiReconnects = pStartRequest->m_uiReconnects;
+    }
+
+    return;
+}
+
 
 int RTSPClientSession::StopRTSPClientSession()
 {
-    shutdownStream(m_pRTSPClient, 1);
+    if(NULL == m_pData->rtspClient()) {
+        return -1;
+    }
+
+    StopRequest stStopRequest;
+    stStopRequest.m_pData = m_pData;
+    stStopRequest.m_bStopped = false;
+    runInLoopThread(StopInLoop, &stStopRequest);
+
+    return stStopRequest.m_bStopped ? 0 : -1;
+}
+
+static void ShutdownStreamLater(void *_pvRTSPClient)
+{
+    ((ourRTSPClient *)_pvRTSPClient)->m_stopTask = NULL;
+    shutdownStream((RTSPClient *)_pvRTSPClient, 1);
+
+    return;
+}
+
+void RTSPClientSession::StopInLoop(void *_pvStopRequest)
+{
+    StopRequest *pStopRequest = (StopRequest *)_pvStopRequest;
+
+    // (Checked again here, because the client may have shut itself down - and been closed - since the caller looked:)
+    ourRTSPClient *pRTSPClient = (ourRTSPClient *)pStopRequest->m_pData->rtspClient();
+    if(NULL == pRTSPClient) {
+        return;
+    }
+    pStopRequest->m_bStopped = true;
+
+    if(0 == frameDeliveryDepth) {
+        shutdownStream(pRTSPClient, 1);
+        return;
+    }
+
+    // We're in a frame callback, so the sink that called it - and the RTP source that called the sink - are still running, and
+    // can't be closed now.  Instead, stop the client delivering frames, leave our queue and m_pData now (as "shutdownStream()"
+    // would), and close it as soon as we're back in the event loop:
+    if(NULL != pRTSPClient->m_pFrameQueue) {
+        pRTSPClient->m_pFrameQueue->close();
+        pRTSPClient->m_pFrameQueue = NULL;
+    }
+    pStopRequest->m_pData->setRTSPClient(NULL);
+    pRTSPClient->m_stopTask = pRTSPClient->envir().taskScheduler().scheduleDelayedTask(0, ShutdownStreamLater, pRTSPClient);
+
+    return;
+}
+
+struct SetVerbosityRequest {
+    RTSPClientSessionData *m_pData;
+    int m_iVerbosity;
+    bool m_bSet;
+};
+
+static void SetVerbosityInLoop(void *_pvSetVerbosityRequest)
+{
+    SetVerbosityRequest *pSetVerbosityRequest = (SetVerbosityRequest *)_pvSetVerbosityRequest;
+
+    // (The client is looked up here, because it may have shut itself down - and been closed - since the caller looked:)
+    ourRTSPClient *pRTSPClient = (ourRTSPClient *)pSetVerbosityRequest->m_pData->rtspClient();
+    if(NULL != pRTSPClient) {
+        pRTSPClient->setVerbosityLevel(pSetVerbosityRequest->m_iVerbosity);
+        pSetVerbosityRequest->m_bSet = true;
+    }
+
+    return;
+}
+
+int RTSPClientSession::SetVerbosity(int _iVerbosity)
+{
+    if(NULL == m_pData->rtspClient()) {
+        return -1;
+    }
+
+    if(_iVerbosity < RTSPC_VERBOSITY_NONE || _iVerbosity > RTSPC_VERBOSITY_PROTOCOL) {
+        return -1;
+    }
+
+    SetVerbosityRequest stSetVerbosityRequest;
+    stSetVerbosityRequest.m_pData = m_pData;
+    stSetVerbosityRequest.m_iVerbosity = _iVerbosity;
+    stSetVerbosityRequest.m_bSet = false;
+    runInLoopThread(SetVerbosityInLoop, &stSetVerbosityRequest);
+
+    return stSetVerbosityRequest.m_bSet ? 0 : -1;
+}
+
+int RTSPClientSession::GetStreamStats(RTSPClientStreamStats *_pstRTSPClientStreamStats, int _iMaxStreams)
+{
+    if(NULL == m_pData->rtspClient() || NULL == _pstRTSPClientStreamStats || _iMaxStreams <= 0) {
+        return -1;
+    }
+
+    //(From m_pData, not the client: the client may be closed - by the event loop - at any moment)
+    return m_pData->getStreamStats(_pstRTSPClientStreamStats, _iMaxStreams);
+}
+
+int RTSPClientSession::GetLatencyStats(RTSPClientLatencyStats *_pstRTSPClientLatencyStats, int _iMaxStages)
+{
+    if(NULL == m_pData->rtspClient() || NULL == _pstRTSPClientLatencyStats || _iMaxStages <= 0) {
+        return -1;
+    }
+
+    int iNumStages = _iMaxStages < RTSPC_LATENCY_STAGES ? _iMaxStages : RTSPC_LATENCY_STAGES;
+    for(int i = 0; i < iNumStages; i++) {
+        m_pData->latency()[i].summarize(_pstRTSPClientLatencyStats[i]);//(from m_pData, which outlives the client)
+    }
+
+    return iNumStages;
+}
+
+static void ResetLatencyInLoop(void *_pvSessionData)
+{
+    ((RTSPClientSessionData *)_pvSessionData)->resetLatency();
+
+    return;
+}
+
+int RTSPClientSession::ResetLatencyStats()
+{
+    if(NULL == m_pData->rtspClient()) {
+        return -1;
+    }
+
+    runInLoopThread(ResetLatencyInLoop, m_pData);
+
+    return 0;
+}
+
+int RTSPClientSession::GetFrame(RTSPClientFrame *_pstRTSPClientFrame, int _iTimeoutMs)
+{
+    if(NULL == m_pFrameQueue || NULL == _pstRTSPClientFrame) {
+        return -1;
+    }
+
+    return m_pFrameQueue->pop(_pstRTSPClientFrame, _iTimeoutMs < 0 ? -1 : _iTimeoutMs);
+}
+
+int RTSPClientSession::TryGetFrame(RTSPClientFrame *_pstRTSPClientFrame)
+{
+    return GetFrame(_pstRTSPClientFrame, 0);
+}
+
+int RTSPClientSession::ReleaseFrame(RTSPClientFrame *_pstRTSPClientFrame)
+{
+    if(NULL == m_pFrameQueue || NULL == _pstRTSPClientFrame) {
+        return -1;
+    }
+
+    m_pFrameQueue->release(_pstRTSPClientFrame);
+
+    return 0;
+}
+
+int RTSPClientSession::GetFrames(RTSPClientFrame *_pstRTSPClientFrames, int _iMaxFrames)
+{
+    if(NULL == m_pFrameQueue || NULL == _pstRTSPClientFrames || _iMaxFrames <= 0) {
+        return -1;
+    }
+
+    return m_pFrameQueue->popAvailable(_pstRTSPClientFrames, (unsigned)_iMaxFrames);
+}
+
+int RTSPClientSession::GetFrameFd()
+{
+    if(NULL == m_pFrameQueue) {
+        return -1;
+    }
+
+    return m_pFrameQueue->eventFd();
+}
+
+int RTSPClientSession::SetClientPortRange(unsigned short _usFirstPort, unsigned short _usLastPort)
+{
+    if(!RTSPClientPortPool::setRange(_usFirstPort, _usLastPort)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void CopyLoopUsage(RTSPClientLoopUsage const &_loopUsage, RTSPClientLoopStats *_pstRTSPClientLoopStats)
+{
+    for(int i = 0; i < RTSPC_LOOP_HANDLER_TYPES; i++) {
+        _pstRTSPClientLoopStats->m_aullHandlerUs[i] = _loopUsage.usecs(i);
+        _pstRTSPClientLoopStats->m_aullHandlerCalls[i] = _loopUsage.calls(i);
+        _pstRTSPClientLoopStats->m_auiHandlerMaxUs[i] = (unsigned int)_loopUsage.maxUsecs(i);
+    }
+    _pstRTSPClientLoopStats->m_ullStalls = _loopUsage.stalls();
+
+    return;
+}
+
+int RTSPClientSession::GetLoopStats(RTSPClientLoopStats *_pstRTSPClientLoopStats)
+{
+    RTSPClientTaskScheduler *pScheduler = (RTSPClientTaskScheduler *)RTSPClientSession::m_pscheduler;
+    if(NULL == _pstRTSPClientLoopStats || NULL == pScheduler || !pScheduler->isProfiling()) {
+        return -1;
+    }
+
+    memset(_pstRTSPClientLoopStats, 0, sizeof(RTSPClientLoopStats));
+    _pstRTSPClientLoopStats->m_ullWaitUs = pScheduler->waitUsecs();
+    CopyLoopUsage(pScheduler->totalUsage(), _pstRTSPClientLoopStats);
+    pScheduler->lag().summarize(_pstRTSPClientLoopStats->m_stLag);
+
+    return 0;
+}
+
+int RTSPClientSession::GetLoopUsage(RTSPClientLoopStats *_pstRTSPClientLoopStats)
+{
+    RTSPClientTaskScheduler *pScheduler = (RTSPClientTaskScheduler *)RTSPClientSession::m_pscheduler;
+    if(NULL == _pstRTSPClientLoopStats || NULL == m_pData->rtspClient() || NULL == pScheduler || !pScheduler->isProfiling()) {
+        return -1;
+    }
+
+    memset(_pstRTSPClientLoopStats, 0, sizeof(RTSPClientLoopStats));
+    CopyLoopUsage(m_pData->loopUsage(), _pstRTSPClientLoopStats);
+
+    return 0;
+}
+
+int RTSPClientSession::GetStartupTimeline(RTSPClientStartupTimeline *_pstRTSPClientStartupTimeline)
+{
+    if(NULL == _pstRTSPClientStartupTimeline || 0 == m_pData->sessionId()) {
+        return -1;
+    }
+
+    memset(_pstRTSPClientStartupTimeline, 0, sizeof(RTSPClientStartupTimeline));
+    _pstRTSPClientStartupTimeline->m_uiSessionId = m_pData->sessionId();
+    m_pData->timeline().get(*_pstRTSPClientStartupTimeline);
+
+    return 0;
+}
+
+int RTSPClientSession::SetStartupTraceFile(const char *_pcPath)
+{
+    if(NULL == _pcPath) {
+        RTSPClientTimeline::closeTraceFile();
+        return 0;
+    }
+
+    return RTSPClientTimeline::openTraceFile(_pcPath) ? 0 : -1;
+}
+
+int RTSPClientSession::GetTLSStats(RTSPClientTLSStats *_pstRTSPClientTLSStats)
+{
+    if(NULL == _pstRTSPClientTLSStats) {
+        return -1;
+    }
+
+    RTSPClientTLSConnection::getStats(_pstRTSPClientTLSStats);
+
+    return 0;
+}
+
+int RTSPClientSession::SetLogLevel(int _iLevel)
+{
+    if(_iLevel < RTSPC_LOG_LEVEL_NONE || _iLevel > RTSPC_LOG_LEVEL_TRACE) {
+        return -1;
+    }
+
+    RTSPClientLog::setLevel(_iLevel);
+
+    return 0;
+}
+
+int RTSPClientSession::SetLogCallBack(RTSPClient_LogCallBack *_pLogCallBack, void *_pvPri)
+{
+    RTSPClientLog::setCallBack(_pLogCallBack, _pvPri);
 
     return 0;
 }
@@ -0,0 +1,192 @@
+#include <string.h>
+#include <openssl/crypto.h>
+#include "rtspclient_srtp.h"
+
+/*
+ * add 20260610
+ *
+ * SRTP reception, using OpenSSL EVP (see "rtspclient_srtp.h").
+ *
+*/
+
+#define RTSPC_SRTP_CIPHER_KEY_LENGTH  16
+#define RTSPC_SRTP_CIPHER_SALT_LENGTH 14
+#define RTSPC_SRTP_AUTH_KEY_LENGTH    20
+#define RTSPC_SRTP_AUTH_TAG_LENGTH    10
+#define RTSPC_SRTP_MKI_LENGTH         4 // as assumed by "MIKEYState"
+
+// Key derivation labels (RFC 3711, section 4.3.2):
+#define RTSPC_SRTP_LABEL_ENCRYPTION   0x00
+#define RTSPC_SRTP_LABEL_MSG_AUTH     0x01
+#define RTSPC_SRTP_LABEL_SALT         0x02
+
+RTSPClientSRTPContext* RTSPClientSRTPContext::createNew(UsageEnvironment& env, MIKEYState const& mikeyState) {
+  RTSPClientSRTPContext* srtpContext = new RTSPClientSRTPContext(env, mikeyState);
+  if (!srtpContext->deriveKeys(mikeyState.keyData())) {
+    env.setResultMsg("Failed to set up the SRTP keys");
+    delete srtpContext;
+    return NULL;
+  }
+
+  return srtpContext;
+}
+
+RTSPClientSRTPContext::RTSPClientSRTPContext(UsageEnvironment& env, MIKEYState const& mikeyState)
+  : fEnv(env), fEncrypt(mikeyState.encryptSRTP()), fAuthenticate(mikeyState.useAuthentication()),
+    fHaveReceivedSRTPPackets(False), fHighestSeqNum(0), fROC(0), fNumPacketsDropped(0) {
+  // Like "SRTPCryptographicContext", we expect a (4-byte) MKI whenever packets are encrypted or authenticated:
+  fTrailerSize = (fEncrypt || fAuthenticate ? RTSPC_SRTP_MKI_LENGTH : 0) + (fAuthenticate ? RTSPC_SRTP_AUTH_TAG_LENGTH : 0);
+
+  fCipherCtx = EVP_CIPHER_CTX_new();
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  HMAC_CTX_init(&fHMACCtxStorage);
+  fHMACCtx = &fHMACCtxStorage;
+#else
+  fHMACCtx = HMAC_CTX_new();
+#endif
+}
+
+RTSPClientSRTPContext::~RTSPClientSRTPContext() {
+  if (fCipherCtx != NULL) EVP_CIPHER_CTX_free(fCipherCtx);
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+  HMAC_CTX_cleanup(fHMACCtx);
+#else
+  HMAC_CTX_free(fHMACCtx);
+#endif
+}
+
+void RTSPClientSRTPContext::installOn(RTPSource* rtpSource, RTSPClientSRTPContext* srtpContext) {
+  if (rtpSource == NULL) return;
+
+  if (srtpContext != NULL) {
+    rtpSource->setCrypto(NULL); // we decrypt incoming packets ourself, before the RTP source sees them
+    rtpSource->setAuxilliaryReadHandler(auxReadHandler, srtpContext);
+  } else {
+    rtpSource->setAuxilliaryReadHandler(NULL, NULL);
+  }
+}
+
+Boolean RTSPClientSRTPContext::deriveKeys(u_int8_t const* masterKeyPlusSalt) {
+  if (fCipherCtx == NULL || fHMACCtx == NULL) return False;
+
+  u_int8_t const* masterKey = masterKeyPlusSalt;
+  u_int8_t const* masterSalt = &masterKeyPlusSalt[RTSPC_SRTP_CIPHER_KEY_LENGTH];
+
+  // Each session key is the AES-CM keystream for IV = (<master salt> XOR (<label> << 48)) * 2^16
+  // (RFC 3711, section 4.3.1; we assume a key derivation rate of 0):
+  u_int8_t const labels[3] = { RTSPC_SRTP_LABEL_ENCRYPTION, RTSPC_SRTP_LABEL_MSG_AUTH, RTSPC_SRTP_LABEL_SALT };
+  unsigned const keyLengths[3] = { RTSPC_SRTP_CIPHER_KEY_LENGTH, RTSPC_SRTP_AUTH_KEY_LENGTH, RTSPC_SRTP_CIPHER_SALT_LENGTH };
+  u_int8_t cipherKey[RTSPC_SRTP_CIPHER_KEY_LENGTH], authKey[RTSPC_SRTP_AUTH_KEY_LENGTH];
+  u_int8_t* results[3] = { cipherKey, authKey, fSessionSalt };
+
+  Boolean result = True;
+  for (unsigned i = 0; i < 3 && result; ++i) {
+    u_int8_t iv[16];
+    memcpy(iv, masterSalt, RTSPC_SRTP_CIPHER_SALT_LENGTH);
+    iv[7] ^= labels[i];
+    iv[14] = iv[15] = 0;
+
+    u_int8_t zeros[32];
+    memset(zeros, 0, sizeof zeros);
+    int outLen;
+    result = EVP_EncryptInit_ex(fCipherCtx, EVP_aes_128_ctr(), NULL, masterKey, iv) == 1
+      && EVP_EncryptUpdate(fCipherCtx, results[i], &outLen, zeros, keyLengths[i]) == 1;
+  }
+
+  // Key our contexts once, with the session keys.  From now on, only the IV (for AES) changes for each packet:
+  result = result
+    && EVP_DecryptInit_ex(fCipherCtx, EVP_aes_128_ctr(), NULL, cipherKey, NULL) == 1
+    && HMAC_Init_ex(fHMACCtx, authKey, RTSPC_SRTP_AUTH_KEY_LENGTH, EVP_sha1(), NULL) == 1;
+
+  OPENSSL_cleanse(cipherKey, sizeof cipherKey);
+  OPENSSL_cleanse(authKey, sizeof authKey);
+  return result;
+}
+
+Boolean RTSPClientSRTPContext::processIncomingSRTPPacket(u_int8_t* buffer, unsigned inPacketSize,
+                                                         unsigned& outPacketSize) {
+  if (inPacketSize < 12 + fTrailerSize) return False; // too short
+
+  // Figure out the extent of the (unencrypted) RTP header:
+  unsigned headerSize = 12 + 4*(buffer[0]&0x0F);
+  if (buffer[0]&0x10) { // there's a RTP header extension
+    if (headerSize + 4 > inPacketSize - fTrailerSize) return False;
+    headerSize += 4 + 4*((buffer[headerSize+2]<<8)|buffer[headerSize+3]);
+  }
+  unsigned const packetSizeWithoutTrailer = inPacketSize - fTrailerSize;
+  if (headerSize > packetSizeWithoutTrailer) return False;
+
+  // Estimate the packet's index (i.e., its rollover counter "v"), from its RTP sequence number:
+  u_int16_t const seqNum = (buffer[2]<<8)|buffer[3];
+  u_int32_t v = fROC;
+  if (fHaveReceivedSRTPPackets) {
+    if (fHighestSeqNum < 0x8000) {
+      if (seqNum - fHighestSeqNum > 0x8000 && fROC > 0) v = fROC - 1;
+    } else {
+      if (fHighestSeqNum - 0x8000 > seqNum) v = fROC + 1;
+    }
+  }
+
+  if (fAuthenticate) {
+    // The authentication tag covers the header and the (encrypted) payload, followed by the rollover counter:
+    u_int8_t const rocBytes[4] = { (u_int8_t)(v>>24), (u_int8_t)(v>>16), (u_int8_t)(v>>8), (u_int8_t)v };
+    u_int8_t computedTag[EVP_MAX_MD_SIZE];
+    unsigned computedTagLen;
+    if (HMAC_Init_ex(fHMACCtx, NULL, 0, NULL, NULL) != 1
+        || HMAC_Update(fHMACCtx, buffer, packetSizeWithoutTrailer) != 1
+        || HMAC_Update(fHMACCtx, rocBytes, sizeof rocBytes) != 1
+        || HMAC_Final(fHMACCtx, computedTag, &computedTagLen) != 1) {
+      return False;
+    }
+    if (CRYPTO_memcmp(computedTag, &buffer[inPacketSize - RTSPC_SRTP_AUTH_TAG_LENGTH], RTSPC_SRTP_AUTH_TAG_LENGTH) != 0) {
+      return False;
+    }
+  }
+
+  if (fEncrypt && packetSizeWithoutTrailer > headerSize) {
+    // IV = (<session salt> * 2^16) XOR (<SSRC> * 2^64) XOR (<index> * 2^16):
+    u_int8_t iv[16];
+    memcpy(iv, fSessionSalt, RTSPC_SRTP_CIPHER_SALT_LENGTH);
+    iv[14] = iv[15] = 0;
+    for (unsigned i = 0; i < 4; ++i) iv[4+i] ^= buffer[8+i]; // SSRC
+    iv[8] ^= v>>24; iv[9] ^= v>>16; iv[10] ^= v>>8; iv[11] ^= v;
+    iv[12] ^= seqNum>>8; iv[13] ^= seqNum;
+
+    int outLen;
+    if (EVP_DecryptInit_ex(fCipherCtx, NULL, NULL, NULL, iv) != 1
+        || EVP_DecryptUpdate(fCipherCtx, &buffer[headerSize], &outLen,
+                             &buffer[headerSize], packetSizeWithoutTrailer - headerSize) != 1) {
+      return False;
+    }
+  }
+
+  // The packet is OK, so update our rollover counter state:
+  if (!fHaveReceivedSRTPPackets) {
+    fHaveReceivedSRTPPackets = True;
+    fHighestSeqNum = seqNum;
+  } else if (v == fROC + 1) {
+    fROC = v;
+    fHighestSeqNum = seqNum;
+  } else if (v == fROC && seqNum > fHighestSeqNum) {
+    fHighestSeqNum = seqNum;
+  }
+
+  outPacketSize = packetSizeWithoutTrailer;
+  return True;
+}
+
+void RTSPClientSRTPContext::auxReadHandler(void* clientData, unsigned char* packet, unsigned& packetSize) {
+  RTSPClientSRTPContext* srtpContext = (RTSPClientSRTPContext*)clientData;
+  if (packetSize == 0) return; // nothing was read (e.g., the packet is being held for reordering)
+  if (packetSize >= 2 && packet[1] >= 200 && packet[1] <= 204) {
+    return; // a SRTCP packet (muxed on the RTP socket; RFC 5761) - for the "RTCPInstance", which decrypts it with live555's context
+  }
+
+  unsigned outPacketSize;
+  if (srtpContext->processIncomingSRTPPacket(packet, packetSize, outPacketSize)) {
+    packetSize = outPacketSize;
+  } else {
+    ++srtpContext->fNumPacketsDropped;
+    packetSize = 0; // the RTP source ignores packets that are too short
+  }
+}
@@ -0,0 +1,206 @@
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "rtspclient_self.h"
+#include "rtspclient_timeline.h"
+#include "rtspclient_latency.h"
+
+/*
+ * add 20261019
+ *
+ * The timeline of a session's startup, and its trace file (see "rtspclient_timeline.h").
+ *
+*/
+
+static char const* const phaseNames[RTSPCLIENT_TIMELINE_PHASES] = {
+  "DNS", "connect", "DESCRIBE", "SETUP", "PLAY", "first RTP", "first keyframe", "first callback"
+};
+
+// The trace file (shared by all sessions):
+static pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static FILE* traceFile = NULL;
+static unsigned long numTraceEvents = 0; // written to "traceFile" (each after the first is preceded by a comma)
+
+RTSPClientTimeline::RTSPClientTimeline()
+  : fNumSetups(0), fTraced(False) {
+  memset(fBeginUsecs, 0, sizeof fBeginUsecs);
+  memset(fEndUsecs, 0, sizeof fEndUsecs);
+  memset(fSetupBeginUsecs, 0, sizeof fSetupBeginUsecs);
+  memset(fSetupEndUsecs, 0, sizeof fSetupEndUsecs);
+  fStartUsecs = fBeginUsecs[RTSPC_PHASE_DNS] = RTSPClientLatencyHistogram::nowUsecs();
+}
+
+void RTSPClientTimeline::reset() {
+  // (Another thread may be in "get()", so store each field as it reads it:)
+  __atomic_store_n(&fNumSetups, 0, __ATOMIC_RELAXED);
+  for (unsigned i = 0; i < RTSPCLIENT_TIMELINE_PHASES; ++i) {
+    __atomic_store_n(&fBeginUsecs[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&fEndUsecs[i], 0, __ATOMIC_RELAXED);
+  }
+  for (unsigned i = 0; i < RTSPCLIENT_TIMELINE_MAX_SETUPS; ++i) {
+    __atomic_store_n(&fSetupBeginUsecs[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&fSetupEndUsecs[i], 0, __ATOMIC_RELAXED);
+  }
+  fTraced = False;
+  u_int64_t now = RTSPClientLatencyHistogram::nowUsecs();
+  setStartUsecs(now);
+  __atomic_store_n(&fBeginUsecs[RTSPC_PHASE_DNS], now, __ATOMIC_RELAXED);
+}
+
+void RTSPClientTimeline::storeOnce(u_int64_t& field, u_int64_t usecs) {
+  if (field != 0) return; // only the first time counts
+  __atomic_store_n(&field, usecs != 0 ? usecs : RTSPClientLatencyHistogram::nowUsecs(), __ATOMIC_RELAXED);
+}
+
+void RTSPClientTimeline::begin(unsigned phase, u_int64_t usecs) {
+  storeOnce(fBeginUsecs[phase], usecs);
+  if (phase == RTSPC_PHASE_PLAY) {
+    storeOnce(fBeginUsecs[RTSPC_PHASE_FIRST_RTP], fBeginUsecs[phase]);
+    storeOnce(fBeginUsecs[RTSPC_PHASE_FIRST_KEYFRAME], fBeginUsecs[phase]);
+    storeOnce(fBeginUsecs[RTSPC_PHASE_FIRST_CALLBACK], fBeginUsecs[phase]);
+  }
+}
+
+void RTSPClientTimeline::end(unsigned phase, u_int64_t usecs) {
+  if (fBeginUsecs[phase] == 0) return; // (e.g., "DESCRIBE" failed because the server's name couldn't be resolved)
+  storeOnce(fEndUsecs[phase], usecs);
+}
+
+void RTSPClientTimeline::beginSetup() {
+  // Count only the "SETUP"s of the first startup (not those of a restart over TCP):
+  if (fBeginUsecs[RTSPC_PHASE_PLAY] != 0 || fNumSetups >= RTSPCLIENT_TIMELINE_MAX_SETUPS) return;
+
+  storeOnce(fSetupBeginUsecs[fNumSetups], 0);
+  begin(RTSPC_PHASE_SETUP, fSetupBeginUsecs[fNumSetups]);
+  __atomic_store_n(&fNumSetups, fNumSetups + 1, __ATOMIC_RELEASE);
+}
+
+void RTSPClientTimeline::endSetup() {
+  if (fBeginUsecs[RTSPC_PHASE_PLAY] != 0 || fNumSetups == 0 || fSetupEndUsecs[fNumSetups-1] != 0) return;
+
+  storeOnce(fSetupEndUsecs[fNumSetups-1], 0);
+  __atomic_store_n(&fEndUsecs[RTSPC_PHASE_SETUP], fSetupEndUsecs[fNumSetups-1], __ATOMIC_RELAXED); // (the last one counts)
+}
+
+// The time of an event, relative to the start (0: it hasn't happened):
+static unsigned sinceStart(u_int64_t const& field, u_int64_t startUsecs) {
+  u_int64_t usecs = __atomic_load_n(&field, __ATOMIC_RELAXED);
+  if (usecs == 0) return 0;
+  return usecs > startUsecs ? (unsigned)(usecs - startUsecs) : 1;
+}
+
+void RTSPClientTimeline::get(RTSPClientStartupTimeline& timeline) const {
+  u_int64_t start = startUsecs();
+  timeline.m_ullStartUs = start;
+  for (unsigned i = 0; i < RTSPCLIENT_TIMELINE_PHASES; ++i) {
+    timeline.m_astPhases[i].m_uiBeginUs = sinceStart(fBeginUsecs[i], start);
+    timeline.m_astPhases[i].m_uiEndUs = sinceStart(fEndUsecs[i], start);
+  }
+  timeline.m_iNumSetups = (int)__atomic_load_n(&fNumSetups, __ATOMIC_ACQUIRE);
+  for (int i = 0; i < timeline.m_iNumSetups; ++i) {
+    timeline.m_astSetups[i].m_uiBeginUs = sinceStart(fSetupBeginUsecs[i], start);
+    timeline.m_astSetups[i].m_uiEndUs = sinceStart(fSetupEndUsecs[i], start);
+  }
+}
+
+// Writes one trace event (a JSON object, given by "format"), with the separator that it needs.  "traceMutex" must be held:
+static void writeTraceEvent(char const* format, ...) __attribute__((format(printf, 1, 2)));
+static void writeTraceEvent(char const* format, ...) {
+  if (numTraceEvents++ > 0) fputs(",\n", traceFile);
+  va_list args;
+  va_start(args, format);
+  vfprintf(traceFile, format, args);
+  va_end(args);
+}
+
+// Copies "str" into "buffer" as the contents of a JSON string (truncating it if necessary):
+static void escapeJSON(char const* str, char* buffer, unsigned bufferSize) {
+  unsigned j = 0;
+  for (; *str != '\0' && j + 7 < bufferSize; ++str) {
+    unsigned char c = (unsigned char)*str;
+    if (c == '"' || c == '\\') {
+      buffer[j++] = '\\';
+      buffer[j++] = c;
+    } else if (c < 0x20) {
+      j += snprintf(&buffer[j], bufferSize - j, "\\u%04x", c);
+    } else {
+      buffer[j++] = c;
+    }
+  }
+  buffer[j] = '\0';
+}
+
+void RTSPClientTimeline::writeTrace(unsigned sessionId, char const* url) {
+  if (fTraced) return;
+
+  RTSPClientStartupTimeline timeline;
+  get(timeline);
+  char escapedURL[512];
+  escapeJSON(url != NULL ? url : "", escapedURL, sizeof escapedURL);
+  unsigned long long const start = timeline.m_ullStartUs;
+  int const pid = (int)getpid();
+
+  pthread_mutex_lock(&traceMutex);
+  if (traceFile != NULL) {
+    fTraced = True;
+
+    // Name the session's row, and show its whole startup (until the last phase that has ended):
+    writeTraceEvent("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"#%u %s\"}}",
+                    pid, sessionId, sessionId, escapedURL);
+    unsigned lastUs = 0;
+    for (unsigned i = 0; i < RTSPCLIENT_TIMELINE_PHASES; ++i) {
+      if (timeline.m_astPhases[i].m_uiEndUs > lastUs) lastUs = timeline.m_astPhases[i].m_uiEndUs;
+    }
+    writeTraceEvent("{\"name\":\"startup\",\"cat\":\"rtsp\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%u,"
+                    "\"args\":{\"url\":\"%s\"}}", start, lastUs, pid, sessionId, escapedURL);
+
+    // The phases up to "PLAY" (which follow one another), and each "SETUP" (within RTSPC_PHASE_SETUP):
+    for (unsigned i = 0; i <= RTSPC_PHASE_PLAY; ++i) {
+      RTSPClientPhase const& phase = timeline.m_astPhases[i]; // alias
+      if (phase.m_uiBeginUs == 0 || phase.m_uiEndUs == 0) continue;
+      writeTraceEvent("{\"name\":\"%s\",\"cat\":\"rtsp\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%u}",
+                      phaseNames[i], start + phase.m_uiBeginUs, phase.m_uiEndUs - phase.m_uiBeginUs, pid, sessionId);
+    }
+    for (int i = 0; i < timeline.m_iNumSetups; ++i) {
+      RTSPClientPhase const& setup = timeline.m_astSetups[i]; // alias
+      if (setup.m_uiEndUs == 0) continue;
+      writeTraceEvent("{\"name\":\"SETUP %d\",\"cat\":\"rtsp\",\"ph\":\"X\",\"ts\":%llu,\"dur\":%u,\"pid\":%d,\"tid\":%u}",
+                      i + 1, start + setup.m_uiBeginUs, setup.m_uiEndUs - setup.m_uiBeginUs, pid, sessionId);
+    }
+
+    // The "first"s (which may overlap "PLAY"):
+    for (unsigned i = RTSPC_PHASE_FIRST_RTP; i < RTSPCLIENT_TIMELINE_PHASES; ++i) {
+      if (timeline.m_astPhases[i].m_uiEndUs == 0) continue;
+      writeTraceEvent("{\"name\":\"%s\",\"cat\":\"rtsp\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%llu,\"pid\":%d,\"tid\":%u}",
+                      phaseNames[i], start + timeline.m_astPhases[i].m_uiEndUs, pid, sessionId);
+    }
+    fflush(traceFile);
+  }
+  pthread_mutex_unlock(&traceMutex);
+}
+
+Boolean RTSPClientTimeline::openTraceFile(char const* path) {
+  closeTraceFile();
+
+  FILE* file = fopen(path, "w");
+  if (file == NULL) return False;
+
+  pthread_mutex_lock(&traceMutex);
+  traceFile = file;
+  numTraceEvents = 0;
+  fputs("[\n", traceFile);
+  pthread_mutex_unlock(&traceMutex);
+  return True;
+}
+
+void RTSPClientTimeline::closeTraceFile() {
+  pthread_mutex_lock(&traceMutex);
+  if (traceFile != NULL) {
+    fputs("\n]\n", traceFile);
+    fclose(traceFile);
+    traceFile = NULL;
+  }
+  pthread_mutex_unlock(&traceMutex);
+}
@@ -0,0 +1,386 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <openssl/x509v3.h>
+#include "GroupsockHelper.hh"
+#include "rtspclient_tls.h"
+
+/*
+ * add 20260603
+ *
+ * "rtsps://" (RTSP over TLS) for RTSPClientSession.
+ *
+ * live555's own "TLSState" makes a new SSL_CTX, and does a full handshake, for every connection.  Instead, we do the TLS
+ * ourselves, in a relay between the "RTSPClient"'s socket and the server, using one shared SSL_CTX, and a per-server cache
+ * of TLS sessions.  A reconnect (e.g., after a camera restart, or when a RTSPC_TRANSPORT_AUTO stream switches to TCP)
+ * can then resume the previous session (by session ID, or by session ticket), rather than doing a full handshake.
+ *
+*/
+
+static SSL_CTX* tlsContext = NULL;
+static HashTable* tlsSessionCache = NULL; // "<server name>:<port>" -> SSL_SESSION*
+static HashTable* tlsCAFilesLoaded = NULL; // CA files that have been loaded into "tlsContext"
+static RTSPClientTLSStats tlsStats; // updated by the event loop thread, and copied by "getStats()" (from any thread)
+static pthread_mutex_t tlsStatsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static SSL_CTX* getTLSContext() {
+  if (tlsContext == NULL) {
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+    SSL_library_init();
+    SSL_load_error_strings();
+#else
+    OPENSSL_init_ssl(0, NULL);
+#endif
+    tlsContext = SSL_CTX_new(SSLv23_client_method());
+    if (tlsContext == NULL) return NULL;
+
+    SSL_CTX_set_options(tlsContext, SSL_OP_NO_SSLv2|SSL_OP_NO_SSLv3);
+    SSL_CTX_set_mode(tlsContext, SSL_MODE_ENABLE_PARTIAL_WRITE|SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+    // Client sessions are kept in our own per-server cache, rather than in OpenSSL's internal cache:
+    SSL_CTX_set_session_cache_mode(tlsContext, SSL_SESS_CACHE_CLIENT|SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+    tlsSessionCache = HashTable::create(STRING_HASH_KEYS);
+    tlsCAFilesLoaded = HashTable::create(STRING_HASH_KEYS);
+  }
+
+  return tlsContext;
+}
+
+static void forgetTLSSession(char const* sessionKey) {
+  if (tlsSessionCache == NULL) return;
+
+  SSL_SESSION* session = (SSL_SESSION*)tlsSessionCache->Lookup(sessionKey);
+  if (session != NULL) {
+    tlsSessionCache->Remove(sessionKey);
+    SSL_SESSION_free(session);
+  }
+}
+
+static unsigned long long threadCPUUs() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+
+  return (unsigned long long)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+char* RTSPClientTLSConnection::convertRTSPSURL(char const* url, char*& serverName) {
+  serverName = NULL;
+  if (url == NULL || strncasecmp(url, "rtsps://", 8) != 0) return NULL;
+
+  char const* authority = &url[8];
+  char const* authorityEnd = strchr(authority, '/');
+  if (authorityEnd == NULL) authorityEnd = &authority[strlen(authority)];
+
+  // Skip over any "<username>[:<password>]@":
+  char const* host = authority;
+  for (char const* p = authority; p < authorityEnd; ++p) {
+    if (*p == '@') host = p + 1;
+  }
+  char const* hostEnd = host;
+  while (hostEnd < authorityEnd && *hostEnd != ':') ++hostEnd;
+  if (hostEnd == host) return NULL; // no host name
+
+  serverName = new char[hostEnd - host + 1];
+  memcpy(serverName, host, hostEnd - host);
+  serverName[hostEnd - host] = '\0';
+
+  // "rtsp://" + <authority> [+ ":<default port>"] + <rest of the URL>:
+  unsigned urlSize = strlen(url) + 16;
+  char* rtspURL = new char[urlSize];
+  int authorityLen = (int)(authorityEnd - authority);
+  if (hostEnd < authorityEnd) {
+    snprintf(rtspURL, urlSize, "rtsp://%.*s%s", authorityLen, authority, authorityEnd);
+  } else {
+    snprintf(rtspURL, urlSize, "rtsp://%.*s:%d%s", authorityLen, authority, RTSPCLIENT_TLS_DEFAULT_PORT, authorityEnd);
+  }
+
+  return rtspURL;
+}
+
+RTSPClientTLSConnection* RTSPClientTLSConnection
+::createNew(UsageEnvironment& env, int socketNum, Boolean isConnected, portNumBits serverPortNum,
+            char const* serverName, char const* caFile) {
+  // Make the socket pair whose other end will replace "socketNum".  (Unlike a loopback TCP connection, no other local process
+  // can connect to it, and see the decrypted RTSP session.)
+  int socketPair[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, socketPair) != 0) {
+    env.setResultErrMsg("Failed to set up the local TLS relay socket: ");
+    return NULL;
+  }
+  makeSocketNonBlocking(socketPair[0]);
+  makeSocketNonBlocking(socketPair[1]);
+
+  // The TCP connection to the server becomes ours:
+  int serverSocketNum = dup(socketNum);
+  if (serverSocketNum < 0) {
+    env.setResultErrMsg("dup() failed: ");
+    closeSocket(socketPair[0]); closeSocket(socketPair[1]);
+    return NULL;
+  }
+
+  char sessionKey[300];
+  snprintf(sessionKey, sizeof sessionKey, "%s:%u", serverName, serverPortNum);
+  RTSPClientTLSConnection* connection = new RTSPClientTLSConnection(env, serverSocketNum, serverName, sessionKey);
+  connection->fLocalSocketNum = socketPair[0];
+  connection->fIsConnected = isConnected;
+  if (!connection->setupTLS(caFile)) {
+    closeSocket(socketPair[1]);
+    delete connection;
+    return NULL;
+  }
+
+  // and "socketNum" (keeping its number, and any handler that the "RTSPClient" has set for it) becomes the socket pair's other end:
+  if (dup2(socketPair[1], socketNum) < 0) {
+    env.setResultErrMsg("dup2() failed: ");
+    closeSocket(socketPair[1]);
+    delete connection;
+    return NULL;
+  }
+  closeSocket(socketPair[1]);
+
+  // Anything that the "RTSPClient" sends before the TLS handshake is done waits in the socket pair:
+  if (isConnected) {
+    connection->handleIO();
+  } else {
+    env.taskScheduler().setBackgroundHandling(serverSocketNum, SOCKET_WRITABLE|SOCKET_EXCEPTION, connectionHandler, connection);
+  }
+
+  return connection;
+}
+
+void RTSPClientTLSConnection::getStats(RTSPClientTLSStats* stats) {
+  pthread_mutex_lock(&tlsStatsMutex);
+  *stats = tlsStats;
+  pthread_mutex_unlock(&tlsStatsMutex);
+}
+
+void RTSPClientTLSConnection::flushSessionCache() {
+  if (tlsSessionCache == NULL) return;
+
+  SSL_SESSION* session;
+  while ((session = (SSL_SESSION*)tlsSessionCache->RemoveNext()) != NULL) {
+    SSL_SESSION_free(session);
+  }
+}
+
+RTSPClientTLSConnection::RTSPClientTLSConnection(UsageEnvironment& env, int serverSocketNum,
+                                                 char const* serverName, char const* sessionKey)
+  : fEnv(env), fServerSocketNum(serverSocketNum), fLocalSocketNum(-1),
+    fIsConnected(False), fHandshakeIsDone(False), fCon(NULL), fHandshakeCPUUs(0),
+    fToServerHead(0), fToServerTail(0), fToLocalHead(0), fToLocalTail(0) {
+  fServerName = strDup(serverName);
+  fSessionKey = strDup(sessionKey);
+}
+
+RTSPClientTLSConnection::~RTSPClientTLSConnection() {
+  if (fCon != NULL) {
+    // Send a "close_notify" (if we can), so that our session stays resumable:
+    if (fHandshakeIsDone) SSL_shutdown(fCon);
+    SSL_free(fCon);
+  }
+
+  fEnv.taskScheduler().disableBackgroundHandling(fServerSocketNum);
+  closeSocket(fServerSocketNum);
+  if (fLocalSocketNum >= 0) {
+    fEnv.taskScheduler().disableBackgroundHandling(fLocalSocketNum);
+    closeSocket(fLocalSocketNum);
+  }
+
+  delete[] fServerName;
+  delete[] fSessionKey;
+}
+
+Boolean RTSPClientTLSConnection::setupTLS(char const* caFile) {
+  SSL_CTX* ctx = getTLSContext();
+  if (ctx == NULL) {
+    fEnv.setResultMsg("Failed to create a TLS context");
+    return False;
+  }
+  SSL_CTX_sess_set_new_cb(ctx, newSessionCallback);
+
+  Boolean verifyServer = caFile != NULL && caFile[0] != '\0';
+  if (verifyServer && tlsCAFilesLoaded->Lookup(caFile) == NULL) {
+    if (SSL_CTX_load_verify_locations(ctx, caFile, NULL) != 1) {
+      fEnv.setResultMsg("Failed to load the TLS CA file ", caFile);
+      return False;
+    }
+    tlsCAFilesLoaded->Add(caFile, (void*)1);
+  }
+
+  fCon = SSL_new(ctx);
+  if (fCon == NULL || SSL_set_fd(fCon, fServerSocketNum) != 1) {
+    fEnv.setResultMsg("Failed to create a TLS connection");
+    return False;
+  }
+  SSL_set_app_data(fCon, this);
+  SSL_set_connect_state(fCon);
+  SSL_set_tlsext_host_name(fCon, fServerName);
+  if (verifyServer) {
+    SSL_set_verify(fCon, SSL_VERIFY_PEER, NULL);
+    X509_VERIFY_PARAM_set1_host(SSL_get0_param(fCon), fServerName, 0);
+  }
+
+  // Try to resume our last session with this server:
+  SSL_SESSION* session = (SSL_SESSION*)tlsSessionCache->Lookup(fSessionKey);
+  if (session != NULL) SSL_set_session(fCon, session);
+
+  return True;
+}
+
+void RTSPClientTLSConnection::connectionHandler(void* clientData, int /*mask*/) {
+  RTSPClientTLSConnection* connection = (RTSPClientTLSConnection*)clientData;
+
+  int err = 0;
+  socklen_t len = sizeof err;
+  if (getsockopt(connection->fServerSocketNum, SOL_SOCKET, SO_ERROR, (char*)&err, &len) < 0 || err != 0) {
+    connection->fEnv.setResultErrMsg("Connection to server failed: ", err);
+    delete connection; // this also closes our end of the "RTSPClient"'s connection
+    return;
+  }
+
+  connection->fIsConnected = True;
+  connection->handleIO();
+}
+
+void RTSPClientTLSConnection::incomingHandler(void* clientData, int /*mask*/) {
+  RTSPClientTLSConnection* connection = (RTSPClientTLSConnection*)clientData;
+  connection->handleIO();
+}
+
+void RTSPClientTLSConnection::handleIO() {
+  int serverConditionSet = 0, localConditionSet = 0;
+
+  Boolean ok = True;
+  if (!fHandshakeIsDone) ok = doHandshake(serverConditionSet);
+  if (ok && fHandshakeIsDone) {
+    serverConditionSet = 0;
+    ok = doRelay(serverConditionSet, localConditionSet);
+  }
+  if (!ok) {
+    delete this;
+    return;
+  }
+
+  fEnv.taskScheduler().setBackgroundHandling(fServerSocketNum, serverConditionSet, incomingHandler, this);
+  fEnv.taskScheduler().setBackgroundHandling(fLocalSocketNum, localConditionSet, incomingHandler, this);
+}
+
+Boolean RTSPClientTLSConnection::doHandshake(int& serverConditionSet) {
+  unsigned long long startCPUUs = threadCPUUs();
+  int result = SSL_connect(fCon);
+  fHandshakeCPUUs += threadCPUUs() - startCPUUs;
+
+  if (result == 1) {
+    fHandshakeIsDone = True;
+    pthread_mutex_lock(&tlsStatsMutex);
+    if (SSL_session_reused(fCon)) {
+      ++tlsStats.m_uiResumedHandshakes;
+      tlsStats.m_ullResumedHandshakeCPUUs += fHandshakeCPUUs;
+    } else {
+      ++tlsStats.m_uiFullHandshakes;
+      tlsStats.m_ullFullHandshakeCPUUs += fHandshakeCPUUs;
+    }
+    pthread_mutex_unlock(&tlsStatsMutex);
+    return True;
+  }
+
+  switch (SSL_get_error(fCon, result)) {
+    case SSL_ERROR_WANT_READ: {
+      serverConditionSet = SOCKET_READABLE|SOCKET_EXCEPTION;
+      return True;
+    }
+    case SSL_ERROR_WANT_WRITE: {
+      serverConditionSet = SOCKET_WRITABLE|SOCKET_EXCEPTION;
+      return True;
+    }
+    default: {
+      // The handshake failed.  Don't try to resume the same session again:
+      pthread_mutex_lock(&tlsStatsMutex);
+      ++tlsStats.m_uiFailedHandshakes;
+      pthread_mutex_unlock(&tlsStatsMutex);
+      forgetTLSSession(fSessionKey);
+      fEnv.setResultMsg("TLS handshake with ", fServerName, " failed");
+      return False;
+    }
+  }
+}
+
+Boolean RTSPClientTLSConnection::doRelay(int& serverConditionSet, int& localConditionSet) {
+  Boolean madeProgress;
+  do {
+    madeProgress = False;
+    serverConditionSet = localConditionSet = 0;
+
+    // "RTSPClient" -> server:
+    if (fToServerHead == fToServerTail) {
+      fToServerHead = fToServerTail = 0;
+      int bytesRead = recv(fLocalSocketNum, (char*)fToServer, sizeof fToServer, 0);
+      if (bytesRead == 0) return False; // the "RTSPClient" has closed its end
+      if (bytesRead > 0) {
+        fToServerTail = bytesRead;
+        madeProgress = True;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        localConditionSet |= SOCKET_READABLE;
+      } else {
+        return False;
+      }
+    }
+    if (fToServerHead < fToServerTail) {
+      int result = SSL_write(fCon, &fToServer[fToServerHead], fToServerTail - fToServerHead);
+      if (result > 0) {
+        fToServerHead += result;
+        madeProgress = True;
+      } else {
+        int err = SSL_get_error(fCon, result);
+        if (err == SSL_ERROR_WANT_READ) serverConditionSet |= SOCKET_READABLE;
+        else if (err == SSL_ERROR_WANT_WRITE) serverConditionSet |= SOCKET_WRITABLE;
+        else return False;
+      }
+    }
+
+    // Server -> "RTSPClient":
+    if (fToLocalHead == fToLocalTail) {
+      fToLocalHead = fToLocalTail = 0;
+      int result = SSL_read(fCon, fToLocal, sizeof fToLocal);
+      if (result > 0) {
+        fToLocalTail = result;
+        madeProgress = True;
+      } else {
+        int err = SSL_get_error(fCon, result);
+        if (err == SSL_ERROR_WANT_READ) serverConditionSet |= SOCKET_READABLE;
+        else if (err == SSL_ERROR_WANT_WRITE) serverConditionSet |= SOCKET_WRITABLE;
+        else return False; // the server closed the connection, or an error
+      }
+    }
+    if (fToLocalHead < fToLocalTail) {
+      int bytesWritten = send(fLocalSocketNum, (char const*)&fToLocal[fToLocalHead], fToLocalTail - fToLocalHead, MSG_NOSIGNAL);
+      if (bytesWritten > 0) {
+        fToLocalHead += bytesWritten;
+        madeProgress = True;
+      } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        localConditionSet |= SOCKET_WRITABLE;
+      } else {
+        return False;
+      }
+    }
+  } while (madeProgress);
+
+  if (serverConditionSet != 0) serverConditionSet |= SOCKET_EXCEPTION;
+  return True;
+}
+
+int RTSPClientTLSConnection::newSessionCallback(SSL* con, SSL_SESSION* session) {
+  RTSPClientTLSConnection* connection = (RTSPClientTLSConnection*)SSL_get_app_data(con);
+  if (connection == NULL || tlsSessionCache == NULL) return 0;
+
+  SSL_SESSION* oldSession = (SSL_SESSION*)tlsSessionCache->Lookup(connection->fSessionKey);
+  if (oldSession == session) return 0; // we already have it
+
+  tlsSessionCache->Add(connection->fSessionKey, session);
+  if (oldSession != NULL) SSL_SESSION_free(oldSession);
+
+  return 1; // we keep the reference to "session"
+}
@@ -0,0 +1,518 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+#include <endian.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "UsageEnvironment.hh"
+#include "rtspclient_uring.h"
+#include "rtspclient_latency.h"
+#include "rtspclient_usdt.h"
+
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+/*
+ * add 20261019
+ *
+ * io_uring polling and multishot reception for "RTSPClientTaskScheduler" (see "rtspclient_uring.h").
+ *
+*/
+
+RTSPClientUring* RTSPClientUring::fCurrent = NULL;
+
+#if defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup) // the kernel headers are recent enough (Linux 6.0)
+
+#define URING_SQ_ENTRIES        256
+#define URING_CQ_ENTRIES        4096 // each received packet has its own completion
+#define URING_BUFFER_GROUP      0
+#define URING_BUFFER_HEADROOM   64 // for the "io_uring_recvmsg_out" header and the source address, before the payload
+#define URING_BUFFER_STRIDE     (URING_BUFFER_HEADROOM + RTSPCLIENT_URING_BUFFER_BYTES)
+
+// Each request's "user_data" says what it's for, in its low 2 bits:
+#define URING_KIND_POLL         1 // the rest is (<poll generation> << 32 | <socket number>) << 2
+#define URING_KIND_RECEIVE      2 // the rest is the (aligned) "ReceiveState*"
+#define URING_KIND_CANCEL       3
+#define URING_KIND_MASK         3
+
+struct RTSPClientUring::Rings {
+  // The submission queue:
+  unsigned* sqHead;
+  unsigned* sqTail;
+  unsigned* sqArray;
+  unsigned sqMask, sqEntries;
+  unsigned sqLocalTail;
+  struct io_uring_sqe* sqes;
+
+  // The completion queue:
+  unsigned* cqHead;
+  unsigned* cqTail;
+  unsigned cqMask;
+  struct io_uring_cqe* cqes;
+
+  // The pool of buffers that the kernel receives into:
+  struct io_uring_buf_ring* bufRing;
+  unsigned short bufRingLocalTail;
+  unsigned numFreeBuffers; // in "bufRing"
+  u_int8_t* buffers;
+
+  void* ringMemory; size_t ringMemorySize;
+  void* sqeMemory; size_t sqeMemorySize;
+  void* bufRingMemory; size_t bufRingMemorySize;
+  void* bufferMemory; size_t bufferMemorySize;
+};
+
+struct RTSPClientUring::ReceiveState {
+  int socketNum;
+  struct msghdr msg; // must outlive the request
+  Boolean armed; // our multishot request is (or may still be) active
+  Boolean stopping; // it won't be re-armed: it has failed, or a datagram was too large
+  Boolean detached; // "stopReceiving()" has been called; delete us once "armed" is False
+  ReceiveState* prevDetached; ReceiveState* nextDetached; // in "fDetachedStates" (if "detached")
+  unsigned head, tail; // received (buffer ids) [head, tail) are still to be read
+  unsigned short bufferIds[RTSPCLIENT_URING_NUM_BUFFERS];
+};
+
+static int uringSetup(unsigned entries, struct io_uring_params* params) {
+  return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+  return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+static int uringRegister(int ringFd, unsigned opcode, void* arg, unsigned numArgs) {
+  return (int)syscall(__NR_io_uring_register, ringFd, opcode, arg, numArgs);
+}
+
+RTSPClientUring* RTSPClientUring::createNew() {
+  RTSPClientUring* uring = new RTSPClientUring;
+  if (!uring->setUp()) {
+    delete uring;
+    return NULL;
+  }
+
+  fCurrent = uring;
+  return uring;
+}
+
+RTSPClientUring::RTSPClientUring()
+  : fRings(NULL), fRingFd(-1), fDetachedStates(NULL), fNumReceivingSockets(0), fMustRearmReceives(False), fCompletionUsecs(0) {
+  memset(fSockets, 0, sizeof fSockets);
+}
+
+RTSPClientUring::~RTSPClientUring() {
+  if (fCurrent == this) fCurrent = NULL;
+
+  // Closing the ring cancels all of its requests (the kernel has its own copy of each "msghdr", so their states can go now):
+  if (fRingFd >= 0) close(fRingFd);
+  for (int i = 0; i < FD_SETSIZE; ++i) delete fSockets[i].receiveState;
+  while (fDetachedStates != NULL) deleteDetached(fDetachedStates);
+
+  if (fRings != NULL) {
+    if (fRings->ringMemory != NULL) munmap(fRings->ringMemory, fRings->ringMemorySize);
+    if (fRings->sqeMemory != NULL) munmap(fRings->sqeMemory, fRings->sqeMemorySize);
+    if (fRings->bufRingMemory != NULL) munmap(fRings->bufRingMemory, fRings->bufRingMemorySize);
+    if (fRings->bufferMemory != NULL) munmap(fRings->bufferMemory, fRings->bufferMemorySize);
+    delete fRings;
+  }
+}
+
+static void* mapMemory(size_t size, int ringFd, off_t offset) {
+  void* result = ringFd >= 0
+    ? mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, ringFd, offset)
+    : mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  return result == MAP_FAILED ? NULL : result;
+}
+
+void RTSPClientUring::returnBuffer(unsigned short bufferId) {
+  Rings* rings = fRings;
+  // (Not "&bufRing->bufs[...]": in C++, the empty struct before "bufs" in its declaration has a size, which moves it.)
+  struct io_uring_buf* buf = (struct io_uring_buf*)rings->bufRing + (rings->bufRingLocalTail&(RTSPCLIENT_URING_NUM_BUFFERS-1));
+  buf->addr = (unsigned long)&rings->buffers[bufferId*URING_BUFFER_STRIDE];
+  buf->len = URING_BUFFER_STRIDE;
+  buf->bid = bufferId;
+  __atomic_store_n(&rings->bufRing->tail, ++rings->bufRingLocalTail, __ATOMIC_RELEASE);
+  ++rings->numFreeBuffers;
+}
+
+Boolean RTSPClientUring::setUp() {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof params);
+  params.flags = IORING_SETUP_CQSIZE|IORING_SETUP_COOP_TASKRUN;
+  params.cq_entries = URING_CQ_ENTRIES;
+  fRingFd = uringSetup(URING_SQ_ENTRIES, &params);
+  if (fRingFd < 0 && errno == EINVAL) { // IORING_SETUP_COOP_TASKRUN is new in Linux 5.19; it's only an optimization
+    memset(&params, 0, sizeof params);
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_CQ_ENTRIES;
+    fRingFd = uringSetup(URING_SQ_ENTRIES, &params);
+  }
+  if (fRingFd < 0) return False; // no io_uring (or it's disabled)
+
+  unsigned const requiredFeatures = IORING_FEAT_SINGLE_MMAP|IORING_FEAT_NODROP|IORING_FEAT_EXT_ARG;
+  if ((params.features&requiredFeatures) != requiredFeatures) return False;
+
+  fRings = new Rings;
+  memset(fRings, 0, sizeof (Rings));
+  Rings& r = *fRings; // alias
+
+  size_t sqRingSize = params.sq_off.array + params.sq_entries*sizeof (unsigned);
+  size_t cqRingSize = params.cq_off.cqes + params.cq_entries*sizeof (struct io_uring_cqe);
+  r.ringMemorySize = sqRingSize > cqRingSize ? sqRingSize : cqRingSize;
+  r.ringMemory = mapMemory(r.ringMemorySize, fRingFd, IORING_OFF_SQ_RING);
+  r.sqeMemorySize = params.sq_entries*sizeof (struct io_uring_sqe);
+  r.sqeMemory = mapMemory(r.sqeMemorySize, fRingFd, IORING_OFF_SQES);
+  if (r.ringMemory == NULL || r.sqeMemory == NULL) return False;
+
+  u_int8_t* ring = (u_int8_t*)r.ringMemory;
+  r.sqHead = (unsigned*)(ring + params.sq_off.head);
+  r.sqTail = (unsigned*)(ring + params.sq_off.tail);
+  r.sqArray = (unsigned*)(ring + params.sq_off.array);
+  r.sqMask = *(unsigned*)(ring + params.sq_off.ring_mask);
+  r.sqEntries = params.sq_entries;
+  r.sqLocalTail = *r.sqTail;
+  r.sqes = (struct io_uring_sqe*)r.sqeMemory;
+  r.cqHead = (unsigned*)(ring + params.cq_off.head);
+  r.cqTail = (unsigned*)(ring + params.cq_off.tail);
+  r.cqMask = *(unsigned*)(ring + params.cq_off.ring_mask);
+  r.cqes = (struct io_uring_cqe*)(ring + params.cq_off.cqes);
+
+  // Set up - and register - the buffer pool (a 'provided buffer ring', new in Linux 5.19):
+  r.bufRingMemorySize = RTSPCLIENT_URING_NUM_BUFFERS*sizeof (struct io_uring_buf);
+  r.bufRingMemory = mapMemory(r.bufRingMemorySize, -1, 0);
+  r.bufferMemorySize = RTSPCLIENT_URING_NUM_BUFFERS*URING_BUFFER_STRIDE;
+  r.bufferMemory = mapMemory(r.bufferMemorySize, -1, 0);
+  if (r.bufRingMemory == NULL || r.bufferMemory == NULL) return False;
+  r.bufRing = (struct io_uring_buf_ring*)r.bufRingMemory;
+  r.buffers = (u_int8_t*)r.bufferMemory;
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof reg);
+  reg.ring_addr = (unsigned long)r.bufRing;
+  reg.ring_entries = RTSPCLIENT_URING_NUM_BUFFERS;
+  reg.bgid = URING_BUFFER_GROUP;
+  if (uringRegister(fRingFd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return False;
+
+  for (unsigned i = 0; i < RTSPCLIENT_URING_NUM_BUFFERS; ++i) returnBuffer(i);
+  return True;
+}
+
+struct io_uring_sqe* RTSPClientUring::getSQE() {
+  Rings* rings = fRings;
+  if (rings->sqLocalTail - __atomic_load_n(rings->sqHead, __ATOMIC_ACQUIRE) >= rings->sqEntries) {
+    // The submission queue is full; submit it now (without waiting):
+    uringEnter(fRingFd, rings->sqEntries, 0, 0, NULL, 0);
+    if (rings->sqLocalTail - __atomic_load_n(rings->sqHead, __ATOMIC_ACQUIRE) >= rings->sqEntries) return NULL;
+  }
+
+  unsigned index = rings->sqLocalTail&rings->sqMask;
+  struct io_uring_sqe* sqe = &rings->sqes[index];
+  memset(sqe, 0, sizeof *sqe);
+  rings->sqArray[index] = index;
+  return sqe;
+}
+
+void RTSPClientUring::queueSQE() {
+  __atomic_store_n(fRings->sqTail, ++fRings->sqLocalTail, __ATOMIC_RELEASE);
+}
+
+void RTSPClientUring::queueCancel(u_int8_t opcode, u_int64_t userData) {
+  struct io_uring_sqe* sqe = getSQE();
+  if (sqe == NULL) return;
+
+  sqe->opcode = opcode;
+  sqe->fd = -1;
+  sqe->addr = userData;
+  sqe->user_data = URING_KIND_CANCEL;
+  queueSQE();
+}
+
+static u_int64_t pollUserData(int socketNum, unsigned generation) {
+  return ((((u_int64_t)generation) << 32 | (unsigned)socketNum) << 2) | URING_KIND_POLL;
+}
+
+void RTSPClientUring::armPoll(int socketNum, int conditionSet) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE) return;
+  cancelPoll(socketNum);
+
+  struct io_uring_sqe* sqe = getSQE();
+  if (sqe == NULL) return;
+
+  unsigned events = 0;
+  if (conditionSet&SOCKET_READABLE) events |= POLLIN;
+  if (conditionSet&SOCKET_WRITABLE) events |= POLLOUT;
+  if (conditionSet&SOCKET_EXCEPTION) events |= POLLPRI;
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = socketNum;
+#if __BYTE_ORDER == __BIG_ENDIAN
+  events = events << 16 | events >> 16;
+#endif
+  sqe->poll32_events = events;
+  sqe->user_data = pollUserData(socketNum, fSockets[socketNum].pollGeneration);
+  queueSQE();
+  fSockets[socketNum].pollArmed = True;
+  fSockets[socketNum].pollConditionSet = conditionSet;
+}
+
+void RTSPClientUring::cancelPoll(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE) return;
+
+  SocketState& socket = fSockets[socketNum]; // alias
+  if (socket.pollArmed) {
+    queueCancel(IORING_OP_POLL_REMOVE, pollUserData(socketNum, socket.pollGeneration));
+    socket.pollArmed = False;
+  }
+  socket.pollGeneration = (socket.pollGeneration + 1)&0x3FFFFFFF; // so that it fits in "user_data"
+}
+
+Boolean RTSPClientUring::isPollArmed(int socketNum) const {
+  return socketNum >= 0 && socketNum < FD_SETSIZE && fSockets[socketNum].pollArmed;
+}
+
+unsigned RTSPClientUring::pollGeneration(int socketNum) const {
+  return socketNum >= 0 && socketNum < FD_SETSIZE ? fSockets[socketNum].pollGeneration : 0;
+}
+
+void RTSPClientUring::armReceive(ReceiveState* state) {
+  struct io_uring_sqe* sqe = getSQE();
+  if (sqe == NULL) return;
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = state->socketNum;
+  sqe->addr = (unsigned long)&state->msg;
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = URING_BUFFER_GROUP;
+  sqe->user_data = (u_int64_t)(unsigned long)state | URING_KIND_RECEIVE;
+  queueSQE();
+  state->armed = True;
+}
+
+Boolean RTSPClientUring::startReceiving(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE) return False;
+  if (fSockets[socketNum].receiveState != NULL) return True;
+
+  ReceiveState* state = new ReceiveState;
+  state->socketNum = socketNum;
+  memset(&state->msg, 0, sizeof state->msg);
+  state->msg.msg_namelen = sizeof (struct sockaddr_in);
+  state->armed = state->stopping = state->detached = False;
+  state->prevDetached = state->nextDetached = NULL;
+  state->head = state->tail = 0;
+  fSockets[socketNum].receiveState = state;
+  ++fNumReceivingSockets;
+
+  cancelPoll(socketNum); // the socket's packets now come to us instead
+  armReceive(state);
+  return True;
+}
+
+void RTSPClientUring::stopReceiving(int socketNum) {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || fSockets[socketNum].receiveState == NULL) return;
+
+  ReceiveState* state = fSockets[socketNum].receiveState;
+  fSockets[socketNum].receiveState = NULL;
+  --fNumReceivingSockets;
+
+  while (state->head != state->tail) {
+    returnBuffer(state->bufferIds[state->head++%RTSPCLIENT_URING_NUM_BUFFERS]);
+  }
+  if (state->armed) {
+    queueCancel(IORING_OP_ASYNC_CANCEL, (u_int64_t)(unsigned long)state | URING_KIND_RECEIVE);
+    state->detached = True; // we'll delete it when its final completion arrives (or with the ring)
+    state->nextDetached = fDetachedStates;
+    if (fDetachedStates != NULL) fDetachedStates->prevDetached = state;
+    fDetachedStates = state;
+  } else {
+    delete state;
+  }
+}
+
+Boolean RTSPClientUring::isReceiving(int socketNum) const {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || fSockets[socketNum].receiveState == NULL) return False;
+
+  ReceiveState const* state = fSockets[socketNum].receiveState;
+  return !state->stopping || state->head != state->tail;
+}
+
+Boolean RTSPClientUring::hasPackets(int socketNum) const {
+  if (socketNum < 0 || socketNum >= FD_SETSIZE || fSockets[socketNum].receiveState == NULL) return False;
+
+  ReceiveState const* state = fSockets[socketNum].receiveState;
+  return state->head != state->tail;
+}
+
+int RTSPClientUring::readPacket(int socketNum, unsigned char* buffer, unsigned bufferSize,
+                                struct sockaddr_in& fromAddress) {
+  if (!hasPackets(socketNum)) return 0;
+
+  ReceiveState* state = fSockets[socketNum].receiveState;
+  unsigned short bufferId = state->bufferIds[state->head++%RTSPCLIENT_URING_NUM_BUFFERS];
+  u_int8_t const* buf = &fRings->buffers[bufferId*URING_BUFFER_STRIDE];
+
+  // The buffer holds a "io_uring_recvmsg_out", then the source address (in "msg_namelen" bytes), then the payload:
+  struct io_uring_recvmsg_out const* out = (struct io_uring_recvmsg_out const*)buf;
+  memset(&fromAddress, 0, sizeof fromAddress);
+  memcpy(&fromAddress, &buf[sizeof *out], out->namelen < sizeof fromAddress ? out->namelen : sizeof fromAddress);
+  unsigned packetSize = out->payloadlen;
+  if (packetSize > bufferSize) packetSize = bufferSize; // as "recvfrom()" would do
+  memcpy(buffer, &buf[sizeof *out + state->msg.msg_namelen], packetSize);
+
+  returnBuffer(bufferId);
+  return packetSize;
+}
+
+void RTSPClientUring::deleteDetached(ReceiveState* state) {
+  if (state->prevDetached != NULL) state->prevDetached->nextDetached = state->nextDetached;
+  else fDetachedStates = state->nextDetached;
+  if (state->nextDetached != NULL) state->nextDetached->prevDetached = state->prevDetached;
+  delete state;
+}
+
+static int readinessFromPollEvents(unsigned events, int conditionSet) {
+  // As "select()" would report it:
+  int result = 0;
+  if (events&(POLLIN|POLLHUP|POLLERR)) result |= SOCKET_READABLE;
+  if (events&(POLLOUT|POLLERR)) result |= SOCKET_WRITABLE;
+  if (events&POLLPRI) result |= SOCKET_EXCEPTION;
+
+  result &= conditionSet;
+  return result != 0 ? result : conditionSet; // so that an event that we didn't ask about doesn't make us poll again and again
+}
+
+unsigned RTSPClientUring::wait(long timeoutUsecs, Readiness* readiness, unsigned maxReadiness) {
+  Rings& r = *fRings; // alias
+
+  if (fMustRearmReceives && r.numFreeBuffers > 0) {
+    fMustRearmReceives = False;
+    for (int i = 0, numChecked = 0; i < FD_SETSIZE && numChecked < (int)fNumReceivingSockets; ++i) {
+      ReceiveState* state = fSockets[i].receiveState;
+      if (state == NULL) continue;
+
+      ++numChecked;
+      if (!state->armed && !state->stopping) armReceive(state);
+    }
+  }
+
+  unsigned numToSubmit = r.sqLocalTail - __atomic_load_n(r.sqHead, __ATOMIC_ACQUIRE);
+  Boolean haveCompletions = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE) != *r.cqHead;
+  if (timeoutUsecs != 0 && !haveCompletions) {
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof arg);
+    arg.sigmask_sz = _NSIG/8;
+    if (timeoutUsecs > 0) {
+      ts.tv_sec = timeoutUsecs/1000000;
+      ts.tv_nsec = (timeoutUsecs%1000000)*1000;
+      arg.ts = (unsigned long)&ts;
+    }
+    uringEnter(fRingFd, numToSubmit, 1, IORING_ENTER_GETEVENTS|IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+        // (This fails with ETIME if the timeout expired, or EINTR; either way, we just look at the completion queue.)
+  } else if (numToSubmit > 0) {
+    uringEnter(fRingFd, numToSubmit, 0, 0, NULL, 0);
+  }
+
+  // Handle every completion that has been posted:
+  unsigned numReady = 0;
+  unsigned head = *r.cqHead;
+  unsigned const tail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+  if (head != tail) fCompletionUsecs = RTSPClientLatencyHistogram::nowUsecs();
+  for (; head != tail; ++head) {
+    struct io_uring_cqe const* cqe = &r.cqes[head&r.cqMask];
+    u_int64_t const userData = cqe->user_data;
+
+    if ((userData&URING_KIND_MASK) == URING_KIND_POLL) {
+      int socketNum = (int)((userData >> 2)&0xFFFFFFFF);
+      unsigned generation = (unsigned)(userData >> 34);
+      SocketState& socket = fSockets[socketNum]; // alias
+      if (generation != socket.pollGeneration || !socket.pollArmed) continue; // stale (cancelled)
+
+      if (cqe->res < 0) continue; // e.g., EBADF; leave the poll 'armed', so that we don't keep re-arming it
+      socket.pollArmed = False;
+      if (numReady < maxReadiness) {
+        Readiness& ready = readiness[numReady++]; // alias
+        ready.socketNum = socketNum;
+        ready.conditionSet = readinessFromPollEvents(cqe->res, socket.pollConditionSet);
+        ready.generation = generation;
+      }
+    } else if ((userData&URING_KIND_MASK) == URING_KIND_RECEIVE) {
+      ReceiveState* state = (ReceiveState*)(unsigned long)(userData&~(u_int64_t)URING_KIND_MASK);
+
+      if (cqe->flags&IORING_CQE_F_BUFFER) {
+        unsigned short bufferId = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+        --r.numFreeBuffers;
+        struct io_uring_recvmsg_out const* out = (struct io_uring_recvmsg_out const*)&r.buffers[bufferId*URING_BUFFER_STRIDE];
+        if (state->detached || state->stopping || cqe->res < 0) {
+          returnBuffer(bufferId);
+        } else if (out->flags&MSG_TRUNC) {
+          // This datagram was too large for a pool buffer (and has been lost).  Go back to reading the socket ourself, once
+          // the packets before it have been read:
+          returnBuffer(bufferId);
+          state->stopping = True;
+          if (cqe->flags&IORING_CQE_F_MORE) {
+            queueCancel(IORING_OP_ASYNC_CANCEL, userData);
+          }
+        } else {
+          state->bufferIds[state->tail++%RTSPCLIENT_URING_NUM_BUFFERS] = bufferId;
+        }
+      }
+
+      if ((cqe->flags&IORING_CQE_F_MORE) == 0) {
+        // The request has finished:
+        state->armed = False;
+        if (state->detached) {
+          deleteDetached(state);
+        } else if (!state->stopping) {
+          if (cqe->res == -ENOBUFS || cqe->res >= 0) {
+            // The pool ran out of buffers (or the completion queue overflowed); re-arm once buffers have been given back:
+            if (cqe->res == -ENOBUFS) RTSPCLIENT_PROBE1(pool_exhausted, r.numFreeBuffers);
+            fMustRearmReceives = True;
+          } else {
+            // e.g., EINVAL, from a kernel without multishot "recvmsg()" (before Linux 6.0); read the socket ourself:
+            state->stopping = True;
+          }
+        }
+      }
+    }
+    // (We ignore the completions of our cancellations.)
+  }
+  __atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+
+  return numReady;
+}
+
+#else // no io_uring support at build time
+
+RTSPClientUring* RTSPClientUring::createNew() {
+  return NULL;
+}
+
+RTSPClientUring::RTSPClientUring()
+  : fRings(NULL), fRingFd(-1), fDetachedStates(NULL), fNumReceivingSockets(0), fMustRearmReceives(False), fCompletionUsecs(0) {
+}
+
+RTSPClientUring::~RTSPClientUring() {
+}
+
+Boolean RTSPClientUring::setUp() { return False; }
+void RTSPClientUring::armPoll(int /*socketNum*/, int /*conditionSet*/) {}
+void RTSPClientUring::cancelPoll(int /*socketNum*/) {}
+Boolean RTSPClientUring::isPollArmed(int /*socketNum*/) const { return False; }
+unsigned RTSPClientUring::pollGeneration(int /*socketNum*/) const { return 0; }
+Boolean RTSPClientUring::startReceiving(int /*socketNum*/) { return False; }
+void RTSPClientUring::stopReceiving(int /*socketNum*/) {}
+Boolean RTSPClientUring::isReceiving(int /*socketNum*/) const { return False; }
+Boolean RTSPClientUring::hasPackets(int /*socketNum*/) const { return False; }
+int RTSPClientUring::readPacket(int /*socketNum*/, unsigned char* /*buffer*/, unsigned /*bufferSize*/,
+                                struct sockaddr_in& /*fromAddress*/) { return 0; }
+unsigned RTSPClientUring::wait(long /*timeoutUsecs*/, Readiness* /*readiness*/, unsigned /*maxReadiness*/) { return 0; }
+
+#endif
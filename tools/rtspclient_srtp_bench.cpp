@@ -0,0 +1,185 @@
+/*
+ * The CPU cost per received SRTP packet ("SRTP_AES128_CM_HMAC_SHA1_80", encrypted and authenticated): of live555's own
+ * "SRTPCryptographicContext", and of our EVP-based "RTSPClientSRTPContext" (see "include/rtspclient_srtp.h"), each
+ * calling "processIncomingSRTPPacket()" on the same packets.
+ *
+ * Build:
+ *   g++ -O2 -Iinclude -Iinclude/live555/BasicUsageEnvironment -Iinclude/live555/groupsock -Iinclude/live555/liveMedia \
+ *       -Iinclude/live555/UsageEnvironment tools/rtspclient_srtp_bench.cpp -o rtspclient_srtp_bench \
+ *       -L<librtspclient dir> -lrtspclient -L<live555 lib dir> -lliveMedia -lBasicUsageEnvironment -lgroupsock -lUsageEnvironment \
+ *       -lssl -lcrypto -lpthread
+ *
+ * Usage: rtspclient_srtp_bench <packets> [<packet size>]
+ *   e.g., ./rtspclient_srtp_bench 1000000            (1200-byte RTP packets, before the SRTP trailer)
+ *
+ * The packets (with consecutive sequence numbers) are made - from a fresh MIKEY key - by "protectPacket()" below, and each
+ * is first checked to decrypt back to what it was, by both contexts.  As each call decrypts in place, each packet is copied
+ * into the buffer first; the time for the copying alone is measured too, and taken away.
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include "BasicUsageEnvironment.hh"
+#include "liveMedia.hh"
+#include "rtspclient_srtp.h"
+
+#define NUM_DISTINCT_PACKETS 1024
+#define MKI_LENGTH 4
+#define AUTH_TAG_LENGTH 10
+#define TRAILER_SIZE (MKI_LENGTH + AUTH_TAG_LENGTH)
+
+static u_int8_t cipherKey[16], authKey[20], sessionSalt[14];
+
+static double threadCPUSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+// The SRTP session keys (RFC 3711, section 4.3), from the MIKEY master key and salt:
+static void deriveKeys(u_int8_t const* masterKeyPlusSalt) {
+  u_int8_t* keys[3] = { cipherKey, authKey, sessionSalt };
+  int keyLengths[3] = { sizeof cipherKey, sizeof authKey, sizeof sessionSalt };
+  for (int label = 0; label < 3; ++label) {
+    u_int8_t iv[16], zeros[32];
+    memcpy(iv, &masterKeyPlusSalt[16], 14);
+    iv[7] ^= label;
+    iv[14] = iv[15] = 0;
+    memset(zeros, 0, sizeof zeros);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int outLen;
+    EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), NULL, masterKeyPlusSalt, iv);
+    EVP_EncryptUpdate(ctx, keys[label], &outLen, zeros, keyLengths[label]);
+    EVP_CIPHER_CTX_free(ctx);
+  }
+}
+
+// Encrypts the payload of the RTP packet "packet" (with rollover counter 0), and appends the MKI and the authentication tag:
+static void protectPacket(u_int8_t* packet, unsigned packetSize, u_int32_t mki) {
+  u_int16_t seqNum = (packet[2]<<8)|packet[3];
+  u_int8_t iv[16];
+  memcpy(iv, sessionSalt, 14);
+  iv[14] = iv[15] = 0;
+  for (int i = 0; i < 4; ++i) iv[4+i] ^= packet[8+i]; // SSRC
+  iv[12] ^= seqNum>>8; iv[13] ^= seqNum;
+
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  int outLen;
+  EVP_EncryptInit_ex(ctx, EVP_aes_128_ctr(), NULL, cipherKey, iv);
+  EVP_EncryptUpdate(ctx, &packet[12], &outLen, &packet[12], packetSize - 12);
+  EVP_CIPHER_CTX_free(ctx);
+
+  // The authentication tag covers the packet, followed by the rollover counter (0):
+  memset(&packet[packetSize], 0, 4);
+  u_int8_t tag[EVP_MAX_MD_SIZE];
+  unsigned tagLen;
+  HMAC(EVP_sha1(), authKey, sizeof authKey, packet, packetSize + 4, tag, &tagLen);
+
+  packet[packetSize] = mki>>24; packet[packetSize+1] = mki>>16; packet[packetSize+2] = mki>>8; packet[packetSize+3] = mki;
+  memcpy(&packet[packetSize + MKI_LENGTH], tag, AUTH_TAG_LENGTH);
+}
+
+// Processes "numPackets" packets (cycling through "packets") with "context", returning the CPU time per packet, in ns:
+template <class Context>
+static double timePackets(Context* context, u_int8_t* packets, unsigned srtpPacketSize, unsigned long numPackets,
+                          unsigned long& numFailed) {
+  u_int8_t buffer[65536];
+  numFailed = 0;
+  double startSeconds = threadCPUSeconds();
+  for (unsigned long i = 0; i < numPackets; ++i) {
+    memcpy(buffer, &packets[(i%NUM_DISTINCT_PACKETS)*srtpPacketSize], srtpPacketSize);
+    unsigned outPacketSize;
+    if (context == NULL) {
+      if (buffer[0] == 0xFF) ++numFailed; // (just so that the copying isn't optimized away)
+    } else if (!context->processIncomingSRTPPacket(buffer, srtpPacketSize, outPacketSize)) {
+      ++numFailed;
+    }
+  }
+
+  return (threadCPUSeconds() - startSeconds)*1e9/numPackets;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3 || atol(argv[1]) <= 0) {
+    fprintf(stderr, "Usage: %s <packets> [<packet size>]\n", argv[0]);
+    return 1;
+  }
+  unsigned long numPackets = (unsigned long)atol(argv[1]);
+  unsigned packetSize = argc == 3 ? (unsigned)atoi(argv[2]) : 1200;
+  if (packetSize < 12 || packetSize + TRAILER_SIZE > 65536) {
+    fprintf(stderr, "The packet size must be from 12 to %d\n", 65536 - TRAILER_SIZE);
+    return 1;
+  }
+  unsigned srtpPacketSize = packetSize + TRAILER_SIZE;
+
+  TaskScheduler* scheduler = BasicTaskScheduler::createNew();
+  UsageEnvironment* env = BasicUsageEnvironment::createNew(*scheduler);
+  MIKEYState mikeyState; // a new, random, master key and salt; with encryption and authentication
+  deriveKeys(mikeyState.keyData());
+
+  // Make the (SRTP) packets, keeping their plaintext:
+  u_int8_t* plainPackets = new u_int8_t[NUM_DISTINCT_PACKETS*srtpPacketSize];
+  u_int8_t* packets = new u_int8_t[NUM_DISTINCT_PACKETS*srtpPacketSize];
+  srandom(1);
+  for (unsigned i = 0; i < NUM_DISTINCT_PACKETS; ++i) {
+    u_int8_t* packet = &plainPackets[i*srtpPacketSize];
+    for (unsigned j = 12; j < packetSize; ++j) packet[j] = (u_int8_t)random();
+    packet[0] = 0x80; packet[1] = 96; // V=2; payload type 96
+    packet[2] = i>>8; packet[3] = i; // sequence number
+    u_int32_t timestamp = i*3000;
+    packet[4] = timestamp>>24; packet[5] = timestamp>>16; packet[6] = timestamp>>8; packet[7] = timestamp;
+    packet[8] = 0x12; packet[9] = 0x34; packet[10] = 0x56; packet[11] = 0x78; // SSRC
+    memcpy(&packets[i*srtpPacketSize], packet, packetSize);
+    protectPacket(&packets[i*srtpPacketSize], packetSize, mikeyState.MKI());
+  }
+
+  SRTPCryptographicContext* liveContext = new SRTPCryptographicContext(mikeyState);
+  RTSPClientSRTPContext* ourContext = RTSPClientSRTPContext::createNew(*env, mikeyState);
+  if (ourContext == NULL) {
+    fprintf(stderr, "RTSPClientSRTPContext::createNew() failed: %s\n", env->getResultMsg());
+    return 1;
+  }
+
+  // Check that both contexts decrypt each packet back to what it was:
+  for (unsigned i = 0; i < NUM_DISTINCT_PACKETS; ++i) {
+    u_int8_t buffer[65536];
+    unsigned outPacketSize;
+    memcpy(buffer, &packets[i*srtpPacketSize], srtpPacketSize);
+    if (!liveContext->processIncomingSRTPPacket(buffer, srtpPacketSize, outPacketSize) || outPacketSize != packetSize
+        || memcmp(buffer, &plainPackets[i*srtpPacketSize], packetSize) != 0) {
+      fprintf(stderr, "live555's context failed to decrypt packet %u\n", i);
+      return 1;
+    }
+    memcpy(buffer, &packets[i*srtpPacketSize], srtpPacketSize);
+    if (!ourContext->processIncomingSRTPPacket(buffer, srtpPacketSize, outPacketSize) || outPacketSize != packetSize
+        || memcmp(buffer, &plainPackets[i*srtpPacketSize], packetSize) != 0) {
+      fprintf(stderr, "RTSPClientSRTPContext failed to decrypt packet %u\n", i);
+      return 1;
+    }
+  }
+
+  unsigned long numFailed, numLiveFailed, numOurFailed;
+  double copyNs = timePackets<RTSPClientSRTPContext>(NULL, packets, srtpPacketSize, numPackets, numFailed);
+  double liveNs = timePackets(liveContext, packets, srtpPacketSize, numPackets, numLiveFailed);
+  double ourNs = timePackets(ourContext, packets, srtpPacketSize, numPackets, numOurFailed);
+
+  printf("%u-byte packets: SRTPCryptographicContext %.0f ns/packet, RTSPClientSRTPContext %.0f ns/packet (%.1fx)\n",
+         packetSize, liveNs - copyNs, ourNs - copyNs, (liveNs - copyNs)/(ourNs - copyNs));
+  if (numLiveFailed > 0 || numOurFailed > 0) {
+    printf("(but %lu and %lu packets failed)\n", numLiveFailed, numOurFailed);
+  }
+
+  delete ourContext;
+  delete liveContext;
+  delete[] packets;
+  delete[] plainPackets;
+  env->reclaim();
+  delete scheduler;
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * How late the event loop thread runs a 1 ms periodic timer - e.g., to compare its placement and scheduling options (see
+ * "RTSPClientInitInfo": m_cCPUList, m_iSchedPolicy/m_iSchedPriority and m_iNUMANode) on a loaded machine.
+ *
+ * Build:
+ *   g++ -O2 -Iinclude -Iinclude/live555/BasicUsageEnvironment -Iinclude/live555/groupsock -Iinclude/live555/liveMedia \
+ *       -Iinclude/live555/UsageEnvironment tools/rtspclient_timer_bench.cpp -o rtspclient_timer_bench \
+ *       -L<librtspclient dir> -lrtspclient -L<live555 lib dir> -lliveMedia -lBasicUsageEnvironment -lgroupsock -lUsageEnvironment \
+ *       -lssl -lcrypto -lpthread
+ *
+ * Usage: rtspclient_timer_bench [-c <CPU list>] [-f <SCHED_FIFO priority>] [-n <NUMA node>] [-s <samples>]
+ *   e.g., with 4 busy processes on CPU 0 ("for i in 1 2 3 4; do taskset -c 0 sh -c 'while :; do :; done' & done"):
+ *     taskset -c 0 ./rtspclient_timer_bench              (the default scheduling)
+ *     ./rtspclient_timer_bench -c 0 -f 10                (pinned to CPU 0, SCHED_FIFO priority 10; needs CAP_SYS_NICE)
+ *
+ * Prints the percentiles of the timer's lateness (from when it was due until its handler ran), in microseconds.
+ *
+*/
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include "rtspclient_self.h"
+#include "BasicUsageEnvironment.hh"
+
+#define TIMER_PERIOD_USECS 1000
+
+static unsigned numSamples = 5000;
+static double* latenessUsecs;
+static unsigned numMeasured = 0;
+static double dueUsecs;
+static int done = 0; // set (by the event loop thread) once all of the samples have been taken
+
+static double nowUsecs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+static void timerHandler(void* /*clientData*/) {
+  double now = nowUsecs();
+  latenessUsecs[numMeasured++] = now - dueUsecs;
+  if (numMeasured >= numSamples) {
+    __atomic_store_n(&done, 1, __ATOMIC_RELEASE);
+    return;
+  }
+
+  dueUsecs = now + TIMER_PERIOD_USECS;
+  RTSPClientSession::m_pscheduler->scheduleDelayedTask(TIMER_PERIOD_USECS, timerHandler, NULL);
+}
+
+static void startHandler(void* /*clientData*/) { // (in the event loop thread)
+  dueUsecs = nowUsecs() + TIMER_PERIOD_USECS;
+  RTSPClientSession::m_pscheduler->scheduleDelayedTask(TIMER_PERIOD_USECS, timerHandler, NULL);
+}
+
+int main(int argc, char** argv) {
+  RTSPClientInitInfo initInfo;
+  initInfo.m_bEventFdWakeUp = true;
+  int option;
+  while ((option = getopt(argc, argv, "c:f:n:s:")) != -1) {
+    switch (option) {
+      case 'c': snprintf(initInfo.m_cCPUList, sizeof initInfo.m_cCPUList, "%s", optarg); break;
+      case 'f': initInfo.m_iSchedPolicy = SCHED_FIFO; initInfo.m_iSchedPriority = atoi(optarg); break;
+      case 'n': initInfo.m_iNUMANode = atoi(optarg); break;
+      case 's': numSamples = (unsigned)atoi(optarg); break;
+      default: {
+        fprintf(stderr, "Usage: %s [-c <CPU list>] [-f <SCHED_FIFO priority>] [-n <NUMA node>] [-s <samples>]\n", argv[0]);
+        return 1;
+      }
+    }
+  }
+  if (numSamples == 0) numSamples = 1;
+  latenessUsecs = new double[numSamples];
+
+  if (RTSPClientSession::RTSPClientSessionInit(&initInfo) != 0) {
+    fprintf(stderr, "RTSPClientSessionInit() failed (a bad option, or no permission for SCHED_FIFO?)\n");
+    return 1;
+  }
+  EventTriggerId startTrigger = RTSPClientSession::m_pscheduler->createEventTrigger(startHandler);
+  RTSPClientSession::m_pscheduler->triggerEvent(startTrigger);
+  while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) usleep(100000);
+
+  std::sort(latenessUsecs, latenessUsecs + numSamples);
+  printf("%u samples: p50 %.0f, p99 %.0f, p99.9 %.0f, max %.0f us\n", numSamples, latenessUsecs[numSamples/2],
+         latenessUsecs[numSamples*99/100], latenessUsecs[numSamples*999/1000], latenessUsecs[numSamples-1]);
+
+  RTSPClientSession::RTSPClientSessionDeinit();
+  delete[] latenessUsecs;
+  return 0;
+}
@@ -0,0 +1,195 @@
+/*
+ * The event loop's CPU cost per "rtsps://" TLS handshake, with and without session resumption: a RTSPClientSession
+ * reconnects, over and over, to a TLS server (with a fresh, self-signed, ECDSA P-256 certificate) in a thread of its own
+ * on loopback - first keeping the TLS session cache (so that all but the first handshake resume the previous session), and
+ * then flushing it before each reconnect (so that each handshake is a full one).  The CPU time comes from "GetTLSStats()"
+ * (see "include/rtspclient_tls.h").
+ *
+ * Build:
+ *   g++ -O2 -Iinclude -Iinclude/live555/BasicUsageEnvironment -Iinclude/live555/groupsock -Iinclude/live555/liveMedia \
+ *       -Iinclude/live555/UsageEnvironment tools/rtspclient_tls_bench.cpp -o rtspclient_tls_bench \
+ *       -L<librtspclient dir> -lrtspclient -L<live555 lib dir> -lliveMedia -lBasicUsageEnvironment -lgroupsock -lUsageEnvironment \
+ *       -lssl -lcrypto -lpthread
+ *
+ * Usage: rtspclient_tls_bench <reconnects>
+ *   e.g., ./rtspclient_tls_bench 200
+ *
+ * The server only does the handshake (and then waits for the client to close), so each session's DESCRIBE goes unanswered;
+ * it's stopped once its handshake is done, and then started again.
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include "rtspclient_self.h"
+#include "rtspclient_tls.h"
+#include "BasicUsageEnvironment.hh"
+
+static SSL_CTX* serverContext;
+static int listenSocket;
+static int flushed = 0; // set (by the event loop thread) once the TLS session cache has been flushed
+
+static SSL_CTX* createServerContext() {
+  // A new ECDSA P-256 key, and a self-signed certificate for it:
+  EVP_PKEY* key = NULL;
+  EVP_PKEY_CTX* keyContext = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, NULL);
+  if (keyContext == NULL || EVP_PKEY_keygen_init(keyContext) != 1
+      || EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keyContext, NID_X9_62_prime256v1) != 1
+      || EVP_PKEY_keygen(keyContext, &key) != 1) {
+    return NULL;
+  }
+  EVP_PKEY_CTX_free(keyContext);
+
+  X509* certificate = X509_new();
+  X509_set_version(certificate, 2);
+  ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+  X509_gmtime_adj(X509_get_notBefore(certificate), 0);
+  X509_gmtime_adj(X509_get_notAfter(certificate), 24*60*60);
+  X509_set_pubkey(certificate, key);
+  X509_NAME* name = X509_get_subject_name(certificate);
+  X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (unsigned char const*)"localhost", -1, -1, 0);
+  X509_set_issuer_name(certificate, name);
+  if (X509_sign(certificate, key, EVP_sha256()) == 0) return NULL;
+
+  // The server's defaults: a session cache (for resumption by session ID), and session tickets:
+  SSL_CTX* ctx = SSL_CTX_new(SSLv23_server_method());
+  if (ctx == NULL || SSL_CTX_use_certificate(ctx, certificate) != 1 || SSL_CTX_use_PrivateKey(ctx, key) != 1) return NULL;
+  SSL_CTX_set_session_id_context(ctx, (unsigned char const*)"rtspclient_tls_bench", 20);
+  X509_free(certificate);
+  EVP_PKEY_free(key);
+
+  return ctx;
+}
+
+static void* serverThread(void* /*arg*/) {
+  // Handle one connection at a time: do the handshake, then read (and discard) whatever comes, until the client closes:
+  while (1) {
+    int socketNum = accept(listenSocket, NULL, NULL);
+    if (socketNum < 0) continue;
+
+    SSL* con = SSL_new(serverContext);
+    SSL_set_fd(con, socketNum);
+    if (SSL_accept(con) == 1) {
+      char buffer[4096];
+      while (SSL_read(con, buffer, sizeof buffer) > 0) {}
+      SSL_shutdown(con);
+    }
+    SSL_free(con);
+    close(socketNum);
+  }
+
+  return NULL;
+}
+
+static void flushHandler(void* /*clientData*/) { // (in the event loop thread)
+  RTSPClientTLSConnection::flushSessionCache();
+  __atomic_store_n(&flushed, 1, __ATOMIC_RELEASE);
+}
+
+static int noCallBack(int /*_iType*/, RTSPClientAttr* /*_pstRTSPClientAttr*/, unsigned char* /*_pucData*/, void* /*_pvPri*/) {
+  return RTSPC_CALLBACK_RET_OK;
+}
+
+static unsigned numHandshakes(RTSPClientTLSStats const& stats) {
+  return stats.m_uiFullHandshakes + stats.m_uiResumedHandshakes + stats.m_uiFailedHandshakes;
+}
+
+// Reconnects "numReconnects" times (flushing the TLS session cache first each time, if "flushCache"), and prints the number of
+// each kind of handshake, and the CPU time of each:
+static int reconnect(RTSPClientSession& session, RTSPClientInfo& info, int numReconnects, Boolean flushCache,
+                     EventTriggerId flushTrigger) {
+  RTSPClientTLSStats startStats, stats;
+  RTSPClientSession::GetTLSStats(&startStats);
+
+  for (int i = 0; i < numReconnects; ++i) {
+    if (flushCache) {
+      __atomic_store_n(&flushed, 0, __ATOMIC_RELAXED);
+      RTSPClientSession::m_pscheduler->triggerEvent(flushTrigger);
+      while (!__atomic_load_n(&flushed, __ATOMIC_ACQUIRE)) usleep(100);
+    }
+
+    RTSPClientSession::GetTLSStats(&stats);
+    unsigned handshakesBefore = numHandshakes(stats);
+    if (session.StartRTSPClientSession(&info) != 0) {
+      fprintf(stderr, "StartRTSPClientSession() failed\n");
+      return -1;
+    }
+    for (int waitMs = 0; numHandshakes(stats) == handshakesBefore; ++waitMs) {
+      if (waitMs == 5000) {
+        fprintf(stderr, "No TLS handshake after 5 seconds\n");
+        return -1;
+      }
+      usleep(1000);
+      RTSPClientSession::GetTLSStats(&stats);
+    }
+    usleep(20000); // so that the client also gets the server's TLS 1.3 session tickets (which come after the handshake)
+    session.StopRTSPClientSession();
+  }
+
+  RTSPClientSession::GetTLSStats(&stats);
+  unsigned numFull = stats.m_uiFullHandshakes - startStats.m_uiFullHandshakes;
+  unsigned numResumed = stats.m_uiResumedHandshakes - startStats.m_uiResumedHandshakes;
+  unsigned long long fullCPUUs = stats.m_ullFullHandshakeCPUUs - startStats.m_ullFullHandshakeCPUUs;
+  unsigned long long resumedCPUUs = stats.m_ullResumedHandshakeCPUUs - startStats.m_ullResumedHandshakeCPUUs;
+  printf("session cache %-3s: %u full handshakes (%.0f us CPU each), %u resumed (%.0f us CPU each), %u failed\n",
+         flushCache ? "off" : "on", numFull, numFull > 0 ? (double)fullCPUUs/numFull : 0.0,
+         numResumed, numResumed > 0 ? (double)resumedCPUUs/numResumed : 0.0,
+         stats.m_uiFailedHandshakes - startStats.m_uiFailedHandshakes);
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2 || atoi(argv[1]) <= 0) {
+    fprintf(stderr, "Usage: %s <reconnects>\n", argv[0]);
+    return 1;
+  }
+  int numReconnects = atoi(argv[1]);
+
+  serverContext = createServerContext();
+  if (serverContext == NULL) {
+    fprintf(stderr, "Failed to set up the TLS server\n");
+    return 1;
+  }
+  listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in serverAddress;
+  memset(&serverAddress, 0, sizeof serverAddress);
+  serverAddress.sin_family = AF_INET;
+  serverAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t serverAddressLen = sizeof serverAddress;
+  if (listenSocket < 0 || bind(listenSocket, (struct sockaddr*)&serverAddress, sizeof serverAddress) != 0
+      || listen(listenSocket, 4) != 0
+      || getsockname(listenSocket, (struct sockaddr*)&serverAddress, &serverAddressLen) != 0) {
+    fprintf(stderr, "Failed to set up the server's socket\n");
+    return 1;
+  }
+  pthread_t serverThreadId;
+  pthread_create(&serverThreadId, NULL, serverThread, NULL);
+
+  RTSPClientSession::SetLogLevel(RTSPC_LOG_LEVEL_NONE);
+  if (RTSPClientSession::RTSPClientSessionInit() != 0) {
+    fprintf(stderr, "RTSPClientSessionInit() failed\n");
+    return 1;
+  }
+  EventTriggerId flushTrigger = RTSPClientSession::m_pscheduler->createEventTrigger(flushHandler);
+
+  RTSPClientInfo info;
+  snprintf(info.m_cRTSPUrl, sizeof info.m_cRTSPUrl, "rtsps://127.0.0.1:%u/bench", (unsigned)ntohs(serverAddress.sin_port));
+  info.m_pRTSPClientCallBack = noCallBack;
+  {
+    RTSPClientSession session;
+    if (reconnect(session, info, numReconnects, False, flushTrigger) != 0
+        || reconnect(session, info, numReconnects, True, flushTrigger) != 0) {
+      return 1;
+    }
+  }
+
+  RTSPClientSession::RTSPClientSessionDeinit();
+  return 0;
+}
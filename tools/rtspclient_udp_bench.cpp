@@ -0,0 +1,108 @@
+/*
+ * The event loop's CPU cost per received RTP-over-UDP packet: bursts of 1200-byte datagrams are sent over loopback to one socket,
+ * and then received - through "readSocket()" - by a "BasicTaskScheduler" ("basic"), by a "RTSPClientTaskScheduler" that
+ * batches the socket with "recvmmsg()" ("batched"; see "include/rtspclient_batch.h"), or by one that has the kernel receive
+ * them through its io_uring ("uring"; see "include/rtspclient_uring.h").
+ *
+ * Build (librtspclient must come before libgroupsock, so that its "readSocket()" is the one called):
+ *   g++ -O2 -Iinclude -Iinclude/live555/BasicUsageEnvironment -Iinclude/live555/groupsock -Iinclude/live555/liveMedia \
+ *       -Iinclude/live555/UsageEnvironment tools/rtspclient_udp_bench.cpp -o rtspclient_udp_bench \
+ *       -L<librtspclient dir> -lrtspclient -L<live555 lib dir> -lliveMedia -lBasicUsageEnvironment -lgroupsock -lUsageEnvironment \
+ *       -lssl -lcrypto -lpthread
+ *
+ * Usage: rtspclient_udp_bench basic|batched|uring <rounds> <burst> [sender]
+ *   e.g., for burst in 8 32 256 1000; do for mode in basic batched uring; do ./rtspclient_udp_bench $mode 2000 $burst; done; done
+ *
+ * Each round sends a burst (from the same thread, before the event loop runs), then runs the event loop until the whole burst
+ * has been received; only the event loop's thread CPU time is counted - or, with "sender", the sending too.  (With io_uring, the
+ * copy of each packet into the buffer pool is made as it arrives; over loopback, that's in the sender's "sendto()".)
+ *
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BasicUsageEnvironment.hh"
+#include "GroupsockHelper.hh"
+#include "rtspclient_scheduler.h"
+#include "rtspclient_batch.h"
+
+static UsageEnvironment* env;
+static int receiveSocket;
+static unsigned long numReceived = 0, numToReceive = 0;
+static char watchVariable;
+static unsigned char receiveBuffer[100000];
+
+static void receiveHandler(void* /*clientData*/, int /*mask*/) {
+  struct sockaddr_in fromAddress;
+  if (readSocket(*env, receiveSocket, receiveBuffer, sizeof receiveBuffer, fromAddress) > 0
+      && ++numReceived >= numToReceive) {
+    watchVariable = 1;
+  }
+}
+
+static double threadCPUSeconds() {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec/1e9;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 4 || argc > 5 || (strcmp(argv[1], "basic") != 0 && strcmp(argv[1], "batched") != 0 && strcmp(argv[1], "uring") != 0)
+      || (argc == 5 && strcmp(argv[4], "sender") != 0)) {
+    fprintf(stderr, "Usage: %s basic|batched|uring <rounds> <burst> [sender]\n", argv[0]);
+    return 1;
+  }
+  Boolean uring = strcmp(argv[1], "uring") == 0;
+  Boolean batched = uring || strcmp(argv[1], "batched") == 0;
+  int numRounds = atoi(argv[2]);
+  int burst = atoi(argv[3]);
+  Boolean countSender = argc == 5;
+
+  TaskScheduler* scheduler = batched ? (TaskScheduler*)RTSPClientTaskScheduler::createNew(10000, False, uring)
+                                     : (TaskScheduler*)BasicTaskScheduler::createNew();
+  if (uring && !((RTSPClientTaskScheduler*)scheduler)->usesIOUring()) {
+    fprintf(stderr, "io_uring isn't available (Linux 6.0 or later is needed)\n");
+    return 1;
+  }
+  env = BasicUsageEnvironment::createNew(*scheduler);
+
+  Port port(0);
+  receiveSocket = setupDatagramSocket(*env, port);
+  getSourcePort(*env, receiveSocket, port);
+  increaseReceiveBufferTo(*env, receiveSocket, 8*1024*1024); // so that no burst overflows it
+  if (batched && !RTSPClientBatchReader::enable(receiveSocket)) {
+    fprintf(stderr, "Batching isn't available (is librtspclient linked before libgroupsock?)\n");
+    return 1;
+  }
+  scheduler->setBackgroundHandling(receiveSocket, SOCKET_READABLE, receiveHandler, NULL);
+
+  int sendSocket = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in toAddress;
+  memset(&toAddress, 0, sizeof toAddress);
+  toAddress.sin_family = AF_INET;
+  toAddress.sin_port = port.num();
+  toAddress.sin_addr.s_addr = htonl(0x7F000001);
+  unsigned char packet[1200];
+  memset(packet, 0, sizeof packet);
+
+  double cpuSeconds = 0;
+  for (int round = 0; round < numRounds; ++round) {
+    double sendStartSeconds = threadCPUSeconds();
+    for (int i = 0; i < burst; ++i) {
+      sendto(sendSocket, packet, sizeof packet, 0, (struct sockaddr*)&toAddress, sizeof toAddress);
+    }
+    if (countSender) cpuSeconds += threadCPUSeconds() - sendStartSeconds;
+    numToReceive += burst;
+    watchVariable = 0;
+
+    double startSeconds = threadCPUSeconds();
+    scheduler->doEventLoop(&watchVariable);
+    cpuSeconds += threadCPUSeconds() - startSeconds;
+  }
+
+  printf("%-8s burst %4d: %lu packets, %.0f ns/packet%s\n", argv[1], burst, numReceived, cpuSeconds*1e9/numReceived,
+         countSender ? " (including the sender)" : "");
+  return 0;
+}